@@ -10,6 +10,7 @@ QT += core \
 HEADERS += src/TI_USB_VHCI.h \
     src/test/VirtualUSBdevice.h \
     src/vhci/LinuxVHCIconnector.h \
+    src/vhci/URBChannel.h \
     src/TI_USBhub.h \
     src/TI_WusbStack.h \
     src/config.h \
@@ -19,18 +20,23 @@ HEADERS += src/TI_USB_VHCI.h \
     src/utils/LogAppender.h \
     src/utils/Logger.h \
     src/utils/LogWriter.h \
+    src/utils/SPSCQueue.h \
+    src/utils/BufferPool.h \
     src/azurewave/HubDevice.h \
     src/azurewave/WusbHelperLib.h \
+    src/azurewave/WusbDatagramChannel.h \
     src/azurewave/WusbMessageBuffer.h \
     src/azurewave/WusbReceiverThread.h \
     src/azurewave/WusbStack.h \
-    src/azurewave/XMLmessageDOMparser.h \
+    src/azurewave/WusbURBScheduler.h \
+    src/azurewave/XMLmessageStreamParser.h \
     src/azurewave/ConnectionController.h \
     src/azurewave/ControlMessageBuffer.h \
     src/preferencesbox.h \
     src/Textinfoview.h \
     src/USBinfoTables.h \
     src/USBdeviceInfoProducer.h \
+    src/USBdescriptorCache.h \
     src/BasicUtils.h \
     src/USBconnectionWorker.h \
     src/USButils.h \
@@ -38,23 +44,28 @@ HEADERS += src/TI_USB_VHCI.h \
     src/mainframe.h
 SOURCES += src/test/VirtualUSBdevice.cpp \
     src/vhci/LinuxVHCIconnector.cpp \
+    src/vhci/URBChannel.cpp \
     src/AboutBox.cpp \
     src/utils/LogFileAppender.cpp \
     src/utils/LogConsoleAppender.cpp \
     src/utils/Logger.cpp \
     src/utils/LogWriter.cpp \
+    src/utils/BufferPool.cpp \
     src/azurewave/HubDevice.cpp \
     src/azurewave/WusbHelperLib.cpp \
+    src/azurewave/WusbDatagramChannel.cpp \
     src/azurewave/WusbMessageBuffer.cpp \
     src/azurewave/WusbReceiverThread.cpp \
     src/azurewave/WusbStack.cpp \
-    src/azurewave/XMLmessageDOMparser.cpp \
+    src/azurewave/WusbURBScheduler.cpp \
+    src/azurewave/XMLmessageStreamParser.cpp \
     src/azurewave/ConnectionController.cpp \
     src/azurewave/ControlMessageBuffer.cpp \
     src/preferencesbox.cpp \
     src/Textinfoview.cpp \
     src/USBinfoTables.cpp \
     src/USBdeviceInfoProducer.cpp \
+    src/USBdescriptorCache.cpp \
     src/BasicUtils.cpp \
     src/USBconnectionWorker.cpp \
     src/USButils.cpp \
@@ -9,6 +9,7 @@
 #ifndef TI_USB_VHCI_H_
 #define TI_USB_VHCI_H_
 
+#include "utils/BufferPool.h"
 #include <QThread>
 
 class QByteArray;
@@ -71,6 +72,22 @@ public:
 	 * @param	urbData		Byte array with raw URB data from device
 	 */
 	virtual void giveBackAnswerURB( void * refData, bool isOK, QByteArray * urbData ) = 0;
+	/**
+	 * Passes back an answer to host for last request.
+	 * @param	refData		Pointer to reference data (was given when sending data packet)
+	 * @param	isOK		If request was acknowledged by device
+	 * @param	urbData		Buffer with raw URB data from device (released by host interface)
+	 */
+	virtual void giveBackAnswerURB( void * refData, bool isOK, const PooledBuffer & urbData ) = 0;
+	/**
+	 * Offers the data buffer of host URB as target for answer data (saves a copy when
+	 * giving back answer). Called by network thread - the buffer has to be given back
+	 * with <tt>giveBackAnswerURB</tt> for same URB (or released if answer is dropped).
+	 * @param	refData		Pointer to reference data of URB
+	 * @param	length		Number of bytes needed
+	 * @return	borrowed buffer or an invalid buffer if URB buffer cannot be used
+	 */
+	virtual PooledBuffer reserveAnswerBuffer( void * refData, int length ) { Q_UNUSED( refData ); Q_UNUSED( length ); return PooledBuffer(); }
 };
 
 #endif /* TI_USB_VHCI_H_ */
@@ -86,21 +86,11 @@ public:
 	enum eJobAssignment {
 		JA_NONE,
 		JA_INTERNAL_QUERY_DEVICE,
-		JA_CONNECT_DEVICE
+		JA_CONNECT_DEVICE,
+		/** Connected device is held on its virtual port: import again after hub is reachable */
+		JA_RECONNECT_DEVICE
 	};
 
-	/**
-	 * Creates an empty and invalid instance.<br>
-	 * This method is useful when an <em>invalid</em> instance is
-	 * needed e.g. as return value.
-	 */
-	static inline USBTechDevice & invalid() {
-		// XXX use of some kind of autopointer to keep memory...
-		USBTechDevice *d = new USBTechDevice(0);
-		d->isValid = false;
-		return *d;
-	}
-
 	/** Reference to hub on which this device is connected */
 	HubDevice * parentHub; // TODO refactoring to TI_USBhub
 
@@ -16,6 +16,23 @@
 #include <stdint.h>
 
 class TI_USB_VHCI;
+class URBChannel;
+
+/*
+ * Isochronous URBs (XXX layout inferred - not verified with hub firmware):
+ * Payload of request starts with a packet table: number of packets (4 bytes) followed by
+ * offset and length of each packet (4 bytes each), all little endian; data of OUT transfers follows.
+ * Answer starts with number of packets followed by actual length and status of each packet;
+ * received data of all packets follows (packed in order of packets).
+ * Packet tables are used only if enabled by configuration (see below) - otherwise
+ * isochronous URBs are passed like any other URB (plain data).
+ */
+/** Configuration key: isochronous URBs are passed with packet tables (default: off) */
+#define WUSB_ISO_PACKET_TABLE_CONFIG_KEY	"vhci.isoPacketTable"
+/** Length of packet count at start of an isochronous payload */
+#define WUSB_ISO_TABLE_HEADER_LEN			4
+/** Length of descriptor of one isochronous packet */
+#define WUSB_ISO_PACKET_DESCRIPTOR_LEN		8
 
 class TI_WusbStack : public QObject {
 	Q_OBJECT
@@ -96,6 +113,22 @@ public:
 	 */
 	virtual void registerURBreceiver( TI_USB_VHCI * urbSink ) = 0;
 
+	/**
+	 * Attaches the URB channel of a virtual port: all URBs posted to this channel are
+	 * sent to device. URBs still queued when detaching (<tt>channel == NULL</tt>)
+	 * are given back as failed.
+	 */
+	virtual void attachURBChannel( URBChannel * channel ) = 0;
+
+	/**
+	 * Connection to device is lost but may come back (e.g. hub not reachable for a moment).
+	 * URBs sent and not answered are given back as failed; URBs not sent until now are kept
+	 * and sent after connection is opened again (<tt>openConnection()</tt>). URB channel is
+	 * detached - URBs posted to channel meanwhile are left in channel.
+	 * @return	<code>false</code> if connection was not open
+	 */
+	virtual bool suspendConnection() = 0;
+
 	static QString transferTypeToString( eDataTransferType dataTransferType ) {
 		switch ( dataTransferType ) {
 		case CONTROL_TRANSFER:
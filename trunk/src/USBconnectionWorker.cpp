@@ -13,6 +13,7 @@
 #include "TI_WusbStack.h"
 #include "TI_USB_VHCI.h"
 #include "USBdeviceInfoProducer.h"
+#include "USBdescriptorCache.h"
 #include "azurewave/HubDevice.h"
 #include "vhci/LinuxVHCIconnector.h"
 #include "test/VirtualUSBdevice.h"
@@ -95,7 +96,7 @@ void USBconnectionWorker::queryDevice( const QHostAddress & destinationAddress,
 void USBconnectionWorker::queryDeviceInternal() {
 	if ( logger->isDebugEnabled() )
 		logger->debug( "queryDeviceInternal");
-	stack = parentDevice->createStackForDevice( usbDeviceRef->deviceID );
+	stack = parentDevice->createStackForDevice( usbDeviceRef );
 	connect( stack, SIGNAL(receivedURB(const QByteArray &)), this, SLOT(receivedURB(const QByteArray &)));
 
 	bool openSuccess = stack->openConnection();
@@ -113,6 +114,8 @@ void USBconnectionWorker::queryDeviceInternal() {
 				buffer.clear();
 			}
 		}
+		// descriptors are kept: a later connect of device is answered locally during enumeration
+		USBdescriptorCache::getInstance().store( deviceQueryEngine->getDescriptorSet() );
 		busyWaiting( 5000 );
 		bool closeSuccess = stack->closeConnection();
 		if ( logger->isDebugEnabled() )
@@ -167,7 +170,7 @@ void USBconnectionWorker::connectDeviceInternal() {
 	vhciPortID = portID;
 
 	// open network connection
-	stack = parentDevice->createStackForDevice( usbDeviceRef->deviceID );
+	stack = parentDevice->createStackForDevice( usbDeviceRef );
 	stack->registerURBreceiver( deviceUSBhostConnector );
 
 	bool openSuccess = stack->openConnection();
@@ -180,64 +183,8 @@ void USBconnectionWorker::connectDeviceInternal() {
 
 //	testDev = new VirtualUSBdevice( deviceUSBhostConnector, portID );
 
-	switch ( portID ) {
-	case 1:
-		connect( deviceUSBhostConnector, SIGNAL( urbDataSend1(
-				void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,uint8_t,int)),
-				stack,
-				SLOT(processURB(void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,uint8_t,int)),
-				Qt::QueuedConnection );
-		break;
-	case 2:
-		connect( deviceUSBhostConnector, SIGNAL( urbDataSend2(
-				void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,uint8_t,int)),
-				stack,
-				SLOT(processURB(void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,uint8_t,int)),
-				Qt::QueuedConnection );
-		break;
-	case 3:
-		connect( deviceUSBhostConnector, SIGNAL( urbDataSend3(
-				void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,int)),
-				stack,
-				SLOT(processURB(void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,uint8_t,int)),
-				Qt::QueuedConnection );
-		break;
-	case 4:
-		connect( deviceUSBhostConnector, SIGNAL( urbDataSend4(
-				void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,int)),
-				stack,
-				SLOT(processURB(void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,uint8_t,int)),
-				Qt::QueuedConnection );
-		break;
-	case 5:
-		connect( deviceUSBhostConnector, SIGNAL( urbDataSend5(
-				void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,int)),
-				stack,
-				SLOT(processURB(void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,uint8_t,int)),
-				Qt::QueuedConnection );
-		break;
-	case 6:
-		connect( deviceUSBhostConnector, SIGNAL( urbDataSend6(
-				void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,int)),
-				stack,
-				SLOT(processURB(void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,uint8_t,int)),
-				Qt::QueuedConnection );
-		break;
-	case 7:
-		connect( deviceUSBhostConnector, SIGNAL( urbDataSend7(
-				void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,int)),
-				stack,
-				SLOT(processURB(void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,uint8_t,int)),
-				Qt::QueuedConnection );
-		break;
-	case 8:
-		connect( deviceUSBhostConnector, SIGNAL( urbDataSend8(
-				void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,int)),
-				stack,
-				SLOT(processURB(void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,uint8_t,int)),
-				Qt::QueuedConnection );
-		break;
-	}
+	// URBs of port are passed directly to network stack (and answers back to host)
+	stack->attachURBChannel( deviceUSBhostConnector->getURBChannel( portID ) );
 
 	lastExitCode = WORK_DONE_STILL_RUNNING;
 	currentJob = JOBTYPE_NOWORK;
@@ -245,6 +192,12 @@ void USBconnectionWorker::connectDeviceInternal() {
 
 void USBconnectionWorker::disconnectDevice() {
 	if ( stack ) {
+		// URBs queued in channel of a held port are taken by stack, too: all answers of port
+		// are given back by I/O thread of stack only
+		if ( deviceUSBhostConnector && vhciPortID > 0 )
+			stack->attachURBChannel( deviceUSBhostConnector->getURBChannel( vhciPortID ) );
+		// no more URBs from host - URBs not processed until now are given back as failed
+		stack->attachURBChannel( NULL );
 		if ( !stack->closeConnection() ) {
 			logger->warn("Stack connection not active???");
 		}
@@ -254,59 +207,47 @@ void USBconnectionWorker::disconnectDevice() {
 		deviceUSBhostConnector->disconnectDevice( vhciPortID );
 	}
 
-	switch ( vhciPortID ) {
-	case 1:
-		disconnect( deviceUSBhostConnector, SIGNAL( urbDataSend1(
-				void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,uint8_t,int)),
-				stack,
-				SLOT(processURB(void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,uint8_t,int)) );
-		break;
-	case 2:
-		disconnect( deviceUSBhostConnector, SIGNAL( urbDataSend2(
-				void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,uint8_t,int)),
-				stack,
-				SLOT(processURB(void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,uint8_t,int)) );
-		break;
-	case 3:
-		disconnect( deviceUSBhostConnector, SIGNAL( urbDataSend3(
-				void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,int)),
-				stack,
-				SLOT(processURB(void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,uint8_t,int)) );
-		break;
-	case 4:
-		disconnect( deviceUSBhostConnector, SIGNAL( urbDataSend4(
-				void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,int)),
-				stack,
-				SLOT(processURB(void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,uint8_t,int)) );
-		break;
-	case 5:
-		disconnect( deviceUSBhostConnector, SIGNAL( urbDataSend5(
-				void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,int)),
-				stack,
-				SLOT(processURB(void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,uint8_t,int)));
-		break;
-	case 6:
-		disconnect( deviceUSBhostConnector, SIGNAL( urbDataSend6(
-				void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,int)),
-				stack,
-				SLOT(processURB(void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,uint8_t,int)));
-		break;
-	case 7:
-		disconnect( deviceUSBhostConnector, SIGNAL( urbDataSend7(
-				void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,int)),
-				stack,
-				SLOT(processURB(void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,uint8_t,int)));
-		break;
-	case 8:
-		disconnect( deviceUSBhostConnector, SIGNAL( urbDataSend8(
-				void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,int)),
-				stack,
-				SLOT(processURB(void *,uint16_t,uint8_t,TI_WusbStack::eDataTransferType,TI_WusbStack::eDataDirectionType,QByteArray *,uint8_t,int)));
-		break;
-	}
 	quit();	// exit event looping
 }
 
+bool USBconnectionWorker::holdDevice() {
+	if ( !stack || !deviceUSBhostConnector || vhciPortID < 1 ) return false;
+	if ( deviceUSBhostConnector->getHoldGracePeriod() <= 0 ) return false;
+	// stack gives back URBs it has sent before connector takes over URB channel
+	if ( !stack->suspendConnection() )
+		return false;
+	if ( !deviceUSBhostConnector->holdPort( vhciPortID ) ) {
+		// port is gone already: URBs kept by stack are given back on disconnect
+		logger->warn("Device cannot be held on virtual port");
+		disconnectDevice();
+		return false;
+	}
+	return true;
+}
+
+void USBconnectionWorker::reconnectDevice() {
+	if ( !stack || !deviceUSBhostConnector ) return;
+	if ( !deviceUSBhostConnector->releasePort( vhciPortID ) ) {
+		// grace period is over: URBs queued meanwhile are given back by stack on disconnect
+		logger->warn("Device was not reconnected in time - connection closed");
+		disconnectDevice();
+		return;
+	}
+	if ( !stack->openConnection() ) {
+		logger->warn("Could not reopen connection to hub/device!");
+		// URBs queued in channel are given back as failed on disconnect
+		disconnectDevice();
+		return;
+	}
+	stack->attachURBChannel( deviceUSBhostConnector->getURBChannel( vhciPortID ) );
+	if ( logger->isInfoEnabled() )
+		logger->info(QString("Reconnected device on port %1").arg( QString::number( vhciPortID ) ) );
+}
+
+bool USBconnectionWorker::isHoldExpired() {
+	if ( !deviceUSBhostConnector || vhciPortID < 1 ) return true;
+	return !deviceUSBhostConnector->isPortHeld( vhciPortID );
+}
 
 bool USBconnectionWorker::waitForIncomingURB( int waitMillis ) {
 	int waitCount = 0;
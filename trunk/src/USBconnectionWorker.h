@@ -73,6 +73,20 @@ public:
 	 */
 	void disconnectDevice();
 
+	/**
+	 * Network connection of a connected device is lost (hub not reachable): device is kept on
+	 * its virtual port and URBs of host are queued (see <tt>LinuxVHCIconnector::holdPort</tt>).
+	 * @return	<code>false</code> if device is not held (holding disabled or connection not open)
+	 */
+	bool holdDevice();
+	/**
+	 * Device held on its virtual port was imported again: network connection is reopened and
+	 * queued URBs are sent. If this fails, device is disconnected.
+	 */
+	void reconnectDevice();
+	/** Device is held (see <tt>holdDevice()</tt>) but grace period of port is over */
+	bool isHoldExpired();
+
 	/**
 	 * Thread run loop.<br>
 	 * For technical reasons this method must be declared <em>public</em>...
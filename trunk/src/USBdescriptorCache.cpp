@@ -0,0 +1,216 @@
+/*
+ * USBdescriptorCache.cpp
+ *
+ * @author:		Sebastian Kolbe-Nusser &lt;Sebastian DOT Kolbe AT gmail DOT com&gt;
+ * @version:	$Id$
+ * @created:	2011-05-08
+ */
+
+#include "USBdescriptorCache.h"
+#include "USButils.h"
+#include "utils/Logger.h"
+#include <QMutexLocker>
+
+/** Length of a standard device descriptor */
+#define USB_DEVICE_DESCRIPTOR_LEN		18
+/** Descriptor type of an endpoint descriptor (part of configuration descriptor) */
+#define USB_DESCRIPTOR_TYPE_ENDPOINT	0x05
+/** Min. length of an endpoint descriptor */
+#define USB_ENDPOINT_DESCRIPTOR_LEN		7
+
+static inline uint32_t descriptorKey( uint16_t wValue, uint16_t wIndex ) {
+	return ( ( (uint32_t) wValue ) << 16 ) | wIndex;
+}
+
+USBdescriptorSet::USBdescriptorSet() {
+}
+
+void USBdescriptorSet::insert( uint16_t wValue, uint16_t wIndex, const QByteArray & descriptor ) {
+	if ( descriptor.size() < 2 ) return;
+	uint8_t type = wValue >> 8;
+	int expectedLength;
+	if ( type == USB_DESCRIPTOR_TYPE_CONFIGURATION || type == USB_DESCRIPTOR_TYPE_OTHER_SPEED_CONFIG ||
+			type == USB_DESCRIPTOR_TYPE_BOS ) {
+		// descriptor with sub-descriptors: total length in bytes 2/3
+		if ( descriptor.size() < 4 ) return;
+		expectedLength = ( descriptor[2] & 0xff ) | ( ( descriptor[3] & 0xff ) << 8 );
+	} else
+		expectedLength = descriptor[0] & 0xff;
+	// host asked for first bytes only (e.g. to get total length): not usable for other requests
+	if ( expectedLength < 2 || descriptor.size() < expectedLength ) return;
+	descriptors.insert( descriptorKey( wValue, wIndex ), descriptor.left( expectedLength ) );
+}
+
+bool USBdescriptorSet::lookup( uint16_t wValue, uint16_t wIndex, int maxLength, QByteArray & answer ) const {
+	QHash<uint32_t, QByteArray>::const_iterator it = descriptors.constFind( descriptorKey( wValue, wIndex ) );
+	if ( it == descriptors.constEnd() ) return false;
+	answer = it.value().left( maxLength );
+	return true;
+}
+
+bool USBdescriptorSet::isComplete() const {
+	return descriptors.contains( descriptorKey( USB_DESCRIPTOR_TYPE_DEVICE << 8, 0 ) ) &&
+			descriptors.contains( descriptorKey( USB_DESCRIPTOR_TYPE_CONFIGURATION << 8, 0 ) );
+}
+
+bool USBdescriptorSet::isEmpty() const {
+	return descriptors.isEmpty();
+}
+
+void USBdescriptorSet::clear() {
+	descriptors.clear();
+}
+
+QByteArray USBdescriptorSet::getDeviceDescriptor() const {
+	return descriptors.value( descriptorKey( USB_DESCRIPTOR_TYPE_DEVICE << 8, 0 ) );
+}
+
+int USBdescriptorSet::getVendorID() const {
+	QByteArray device = getDeviceDescriptor();
+	if ( device.size() < USB_DEVICE_DESCRIPTOR_LEN ) return -1;
+	return ( device[8] & 0xff ) | ( ( device[9] & 0xff ) << 8 );
+}
+
+int USBdescriptorSet::getProductID() const {
+	QByteArray device = getDeviceDescriptor();
+	if ( device.size() < USB_DEVICE_DESCRIPTOR_LEN ) return -1;
+	return ( device[10] & 0xff ) | ( ( device[11] & 0xff ) << 8 );
+}
+
+int USBdescriptorSet::getBcdDevice() const {
+	QByteArray device = getDeviceDescriptor();
+	if ( device.size() < USB_DEVICE_DESCRIPTOR_LEN ) return -1;
+	return ( device[12] & 0xff ) | ( ( device[13] & 0xff ) << 8 );
+}
+
+USBdescriptorSet::eDeviceSpeed USBdescriptorSet::getDeviceSpeed() const {
+	QByteArray device = getDeviceDescriptor();
+	if ( device.size() < USB_DEVICE_DESCRIPTOR_LEN ) return SPEED_UNKNOWN;
+	int bcdUSB = ( device[2] & 0xff ) | ( ( device[3] & 0xff ) << 8 );
+	int maxPacketSize0 = device[7] & 0xff;
+
+	// endpoints of first configuration (descriptors of configuration describe current speed)
+	bool haveHighSpeedEndpoint = false;
+	bool haveFullSpeedBulkEndpoint = false;
+	bool onlySmallInterruptEndpoints = true;
+	QByteArray config = descriptors.value( descriptorKey( USB_DESCRIPTOR_TYPE_CONFIGURATION << 8, 0 ) );
+	int idx = 0;
+	while ( idx + 2 <= config.size() ) {
+		int len = config[idx] & 0xff;
+		if ( len < 2 || idx + len > config.size() ) break;
+		if ( ( config[idx+1] & 0xff ) == USB_DESCRIPTOR_TYPE_ENDPOINT && len >= USB_ENDPOINT_DESCRIPTOR_LEN ) {
+			int transferType = config[idx+3] & 0x03;
+			int wMaxPacketSize = ( config[idx+4] & 0xff ) | ( ( config[idx+5] & 0xff ) << 8 );
+			int packetSize = wMaxPacketSize & 0x7ff;
+			bool highBandwidth = ( wMaxPacketSize & 0x1800 ) != 0;
+			switch ( transferType ) {
+			case 2:		// bulk: 512 bytes at high speed, up to 64 bytes at full speed
+				if ( packetSize == 512 ) haveHighSpeedEndpoint = true;
+				else if ( packetSize > 0 && packetSize <= 64 ) haveFullSpeedBulkEndpoint = true;
+				break;
+			case 3:		// interrupt: up to 64 bytes at full speed (8 bytes at low speed)
+				if ( packetSize > 64 || highBandwidth ) haveHighSpeedEndpoint = true;
+				break;
+			case 1:		// isochronous: up to 1023 bytes at full speed
+				if ( packetSize > 1023 || highBandwidth ) haveHighSpeedEndpoint = true;
+				break;
+			}
+			if ( transferType != 3 || packetSize > 8 ) onlySmallInterruptEndpoints = false;
+		}
+		idx += len;
+	}
+
+	if ( config.isEmpty() ) return SPEED_UNKNOWN;
+	// endpoint 0 of a high speed device always takes 64 bytes
+	if ( bcdUSB >= 0x0200 && maxPacketSize0 == 64 && haveHighSpeedEndpoint && !haveFullSpeedBulkEndpoint )
+		return SPEED_HIGH;
+	if ( maxPacketSize0 == 8 && onlySmallInterruptEndpoints && bcdUSB < 0x0200 )
+		return SPEED_LOW;
+	if ( bcdUSB < 0x0200 || maxPacketSize0 != 64 || haveFullSpeedBulkEndpoint )
+		return SPEED_FULL;
+	return SPEED_UNKNOWN;
+}
+
+QString USBdescriptorSet::getSerialNumber() const {
+	QByteArray device = getDeviceDescriptor();
+	if ( device.size() < USB_DEVICE_DESCRIPTOR_LEN || device[16] == 0 ) return QString::null;
+	uint16_t stringID = ( USB_DESCRIPTOR_TYPE_STRING << 8 ) | ( device[16] & 0xff );
+	// serial number is taken in first language of device (if host asked for other languages too)
+	QByteArray languages = descriptors.value( descriptorKey( USB_DESCRIPTOR_TYPE_STRING << 8, 0 ) );
+	if ( languages.size() >= 4 ) {
+		uint16_t langID = ( languages[2] & 0xff ) | ( ( languages[3] & 0xff ) << 8 );
+		if ( descriptors.contains( descriptorKey( stringID, langID ) ) )
+			return USButils::decodeStringDescriptor( descriptors.value( descriptorKey( stringID, langID ) ) );
+	}
+	QHashIterator<uint32_t, QByteArray> it( descriptors );
+	while ( it.hasNext() ) {
+		it.next();
+		if ( ( it.key() >> 16 ) == stringID )
+			return USButils::decodeStringDescriptor( it.value() );
+	}
+	return QString::null;
+}
+
+QString USBdescriptorSet::getKey() const {
+	return QString("%1:%2:%3:%4").arg(
+			QString::number( getVendorID(), 16 ), QString::number( getProductID(), 16 ),
+			QString::number( getBcdDevice(), 16 ), getSerialNumber() );
+}
+
+
+// singleton instance initialization
+USBdescriptorCache * USBdescriptorCache::instance = NULL;
+
+USBdescriptorCache::USBdescriptorCache() {
+	instance = this;
+	logger = Logger::getLogger("DESCCACHE");
+}
+
+USBdescriptorCache::~USBdescriptorCache() {
+	descriptorSets.clear();
+	instance = NULL;
+}
+
+USBdescriptorCache & USBdescriptorCache::getInstance() {
+	if ( !instance ) {
+		new USBdescriptorCache();
+	}
+	return *instance;
+}
+
+void USBdescriptorCache::store( const USBdescriptorSet & descriptorSet ) {
+	if ( !descriptorSet.isComplete() ) return;
+	QString key = descriptorSet.getKey();
+	QMutexLocker locker( &mutex );
+	descriptorSets.insert( key, descriptorSet );
+	if ( logger->isInfoEnabled() )
+		logger->info(QString("Stored descriptors of device %1").arg( key ) );
+}
+
+bool USBdescriptorCache::find( int idVendor, int idProduct, int bcdDevice, USBdescriptorSet & descriptorSet ) {
+	QMutexLocker locker( &mutex );
+	int matches = 0;
+	QHashIterator<QString, USBdescriptorSet> it( descriptorSets );
+	while ( it.hasNext() ) {
+		it.next();
+		if ( it.value().getVendorID() != idVendor || it.value().getProductID() != idProduct ||
+				it.value().getBcdDevice() != bcdDevice )
+			continue;
+		descriptorSet = it.value();
+		matches++;
+	}
+	if ( matches > 1 ) {
+		// identical devices with different serial numbers: cannot tell which one is attached
+		if ( logger->isDebugEnabled() )
+			logger->debug(QString("%1 cached descriptor sets for device %2:%3 - not used").arg(
+					QString::number( matches ), QString::number( idVendor, 16 ), QString::number( idProduct, 16 ) ) );
+		descriptorSet.clear();
+		return false;
+	}
+	return matches == 1;
+}
+
+void USBdescriptorCache::remove( const USBdescriptorSet & descriptorSet ) {
+	QMutexLocker locker( &mutex );
+	descriptorSets.remove( descriptorSet.getKey() );
+}
@@ -0,0 +1,117 @@
+/*
+ * USBdescriptorCache.h
+ * Cache of complete descriptor sets (device, configuration, BOS, strings) of known devices.
+ * Enumeration requests of host for a known device are answered locally instead of
+ * being passed over network.
+ *
+ * @author:		Sebastian Kolbe-Nusser &lt;Sebastian DOT Kolbe AT gmail DOT com&gt;
+ * @version:	$Id$
+ * @created:	2011-05-08
+ */
+
+#ifndef USBDESCRIPTORCACHE_H_
+#define USBDESCRIPTORCACHE_H_
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <stdint.h>
+
+class Logger;
+
+/** USB descriptor types (high byte of <tt>wValue</tt> of GET_DESCRIPTOR) */
+#define USB_DESCRIPTOR_TYPE_DEVICE				0x01
+#define USB_DESCRIPTOR_TYPE_CONFIGURATION		0x02
+#define USB_DESCRIPTOR_TYPE_STRING				0x03
+#define USB_DESCRIPTOR_TYPE_DEVICE_QUALIFIER	0x06
+#define USB_DESCRIPTOR_TYPE_OTHER_SPEED_CONFIG	0x07
+#define USB_DESCRIPTOR_TYPE_BOS					0x0f
+
+/**
+ * All descriptors of one device as answered to GET_DESCRIPTOR requests.
+ * Plain value type (descriptor data is implicitly shared).
+ */
+class USBdescriptorSet {
+public:
+	/** Speed of device as far as it can be told from its descriptors */
+	enum eDeviceSpeed {
+		SPEED_UNKNOWN,
+		SPEED_LOW,
+		SPEED_FULL,
+		SPEED_HIGH
+	};
+
+	USBdescriptorSet();
+
+	/**
+	 * Stores answer of GET_DESCRIPTOR( <tt>wValue</tt>, <tt>wIndex</tt> ).
+	 * Truncated descriptors (answer shorter than descriptor) are ignored.
+	 */
+	void insert( uint16_t wValue, uint16_t wIndex, const QByteArray & descriptor );
+	/**
+	 * Answer for GET_DESCRIPTOR request from stored descriptors.
+	 * @param	maxLength	<tt>wLength</tt> of request
+	 * @return	<code>false</code> if descriptor is not known
+	 */
+	bool lookup( uint16_t wValue, uint16_t wIndex, int maxLength, QByteArray & answer ) const;
+	/** Device descriptor and first configuration descriptor are known */
+	bool isComplete() const;
+	bool isEmpty() const;
+	void clear();
+
+	/** Device descriptor (empty if not known) */
+	QByteArray getDeviceDescriptor() const;
+	int getVendorID() const;
+	int getProductID() const;
+	int getBcdDevice() const;
+	/**
+	 * Speed the device is operating at (on hub): taken from USB version, packet size of
+	 * endpoint 0 and max. packet sizes of endpoints of first configuration (e.g. bulk endpoints
+	 * with 512 bytes packets exist at high speed only).
+	 * @return	<tt>SPEED_UNKNOWN</tt> if descriptors do not tell (e.g. only small interrupt endpoints)
+	 */
+	eDeviceSpeed getDeviceSpeed() const;
+	/** Serial number string of device (null string if device has none or string is not known) */
+	QString getSerialNumber() const;
+	/** Key of descriptor set in cache: vendor, product, release number and serial number */
+	QString getKey() const;
+
+private:
+	/** Descriptors by <tt>wValue</tt> (high word) and <tt>wIndex</tt> (low word) */
+	QHash<uint32_t, QByteArray> descriptors;
+};
+
+class USBdescriptorCache {
+public:
+	~USBdescriptorCache();
+	/**
+	 * Get singleton instance of this class.<br>
+	 * Creation is NOT thread safe - call early (cache itself is thread safe).
+	 */
+	static USBdescriptorCache & getInstance();
+
+	/** Stores a complete descriptor set (replaces a set with same key) */
+	void store( const USBdescriptorSet & descriptorSet );
+	/**
+	 * Finds descriptor set of a device. Devices are identified by vendor, product and
+	 * release number only (serial number is not known before enumeration).
+	 * @return	<code>false</code> if device is not known or if several devices with different
+	 * 			serial numbers match
+	 */
+	bool find( int idVendor, int idProduct, int bcdDevice, USBdescriptorSet & descriptorSet );
+	/** Drops descriptor set (e.g. if device does not match cached descriptors anymore) */
+	void remove( const USBdescriptorSet & descriptorSet );
+
+private:
+	static USBdescriptorCache * instance;
+	Logger * logger;
+	QMutex mutex;
+	QHash<QString, USBdescriptorSet> descriptorSets;
+
+	USBdescriptorCache();
+	// copy constructor needs to be private
+	USBdescriptorCache( const USBdescriptorCache & ) {};
+};
+
+#endif /* USBDESCRIPTORCACHE_H_ */
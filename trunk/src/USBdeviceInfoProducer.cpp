@@ -106,6 +106,7 @@ void USBdeviceInfoProducer::processAnswerURB( const QByteArray & bytes ) {
 	case 0:
 		// device descriptor
 		if ( !bytes.isNull() && !bytes.isEmpty() ) {
+			descriptorSet.insert( USB_DESCRIPTOR_TYPE_DEVICE << 8, 0, bytes );
 			deviceDescriptor = USButils::decodeDeviceDescriptor( bytes );
 			if ( deviceDescriptor.bcdUSB == 0 ) {
 				logger->warn("Error decoding device descriptor!");
@@ -137,6 +138,7 @@ void USBdeviceInfoProducer::processAnswerURB( const QByteArray & bytes ) {
 	case 2:
 		// complete configuration section (including first configuration section and all endpoint descriptors)
 		if ( !bytes.isNull() && !bytes.isEmpty() ) {
+			descriptorSet.insert( USB_DESCRIPTOR_TYPE_CONFIGURATION << 8, 0, bytes );
 			USButils::decodeConfigurationSectionComplete( bytes, configDescriptor );
 			buffer.append( bytes );
 			state = 3;
@@ -145,6 +147,7 @@ void USBdeviceInfoProducer::processAnswerURB( const QByteArray & bytes ) {
 	case 3:
 		// language codes
 		if ( !bytes.isNull() && !bytes.isEmpty() ) {
+			descriptorSet.insert( USB_DESCRIPTOR_TYPE_STRING << 8, 0, bytes );
 			preferedLanguage = USButils::decodeAvailableLanguageCodes( bytes, availableLanguageCodes );
 
 			// debug output of all language codes
@@ -169,6 +172,7 @@ void USBdeviceInfoProducer::processAnswerURB( const QByteArray & bytes ) {
 	case 4:
 		// string descriptor
 		if ( currentStringIDinQuery > 0 ) {
+			descriptorSet.insert( ( USB_DESCRIPTOR_TYPE_STRING << 8 ) | ( currentStringIDinQuery & 0xff ), preferedLanguage, bytes );
 			QString s = USButils::decodeStringDescriptor( bytes );
 			if ( logger->isInfoEnabled() )
 				logger->info(QString("Decode String (index = %1) = %2").arg(
@@ -202,6 +206,10 @@ void USBdeviceInfoProducer::processAnswerURB( const QByteArray & bytes ) {
 	}
 }
 
+const USBdescriptorSet & USBdeviceInfoProducer::getDescriptorSet() const {
+	return descriptorSet;
+}
+
 QString USBdeviceInfoProducer::getHTMLReport() {
 	if ( buffer.isEmpty() ) return QString::null;
 
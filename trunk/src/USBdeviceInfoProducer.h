@@ -14,6 +14,7 @@
 #include <QHash>
 #include "TI_WusbStack.h"
 #include "USButils.h"
+#include "USBdescriptorCache.h"
 #include <stdint.h>
 
 
@@ -37,6 +38,8 @@ public:
 	void processAnswerURB( const QByteArray & bytes );
 
 	QString getHTMLReport();
+	/** Raw descriptors answered by device (for descriptor cache) */
+	const USBdescriptorSet & getDescriptorSet() const;
 private:
 	Logger * logger;
 	int state;
@@ -50,6 +53,7 @@ private:
 	USButils::UsbConfigurationDescriptor configDescriptor;
 	QList<int> listOfStringIDsToquery;
 	QHash<int, QString> stringsByID;
+	USBdescriptorSet descriptorSet;
 
 	QByteArray buffer;
 	QByteArray tempBuffer;
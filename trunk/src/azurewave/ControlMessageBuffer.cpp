@@ -20,118 +20,103 @@ ControlMessageBuffer::ControlMessageBuffer( HubDevice * recipientClass ) {
 	// reserve internal buffer
 	internalBuffer = new QByteArray();
 	internalBuffer->reserve( DEFAULT_BUFFER_SIZE );
-	bytesLeftInCurrentTask = 0;
-	currentMessageTask = TOM_NOP;
+	pendingBytes = new QByteArray();
+	dispatching = false;
+	resetRequested = false;
 }
 
 ControlMessageBuffer::~ControlMessageBuffer() {
 	delete internalBuffer;
+	delete pendingBytes;
 }
 
 void ControlMessageBuffer::receive( const QByteArray & bytes ) {
-/*
-	logger->trace(QString("ControlMessageBuffer - Received %1 bytes; internalBuffer.size = %2; currentTask = %3; "
-			"bytesLeftInCurrentTask = %4").arg(
-					QString::number(bytes.size()),
-					QString::number(internalBuffer->size()),
-					typeOfMessageToString( currentMessageTask ),
-					QString::number( bytesLeftInCurrentTask )
-					) );
-	logger->trace( QString("ControlMessageBuffer - Header: %1 %2 %3 %4 %5 %6 %7").arg(
-			QString::number(bytes[0]&0xff,16),
-			QString::number(bytes[1]&0xff,16),
-			QString::number(bytes[2]&0xff,16),
-			QString::number(bytes[3]&0xff,16),
-			QString::number(bytes[4]&0xff,16),
-			QString::number(bytes[5]&0xff,16),
-			bytes.length()> 6? QString::number(bytes[6],16) : QString("-")
-	));
-*/
-	// put all data into internal buffer
-	internalBuffer->append( bytes );
-	// if there is no task to complete from last invocation - get type of task and length:
-	if ( currentMessageTask == TOM_NOP || bytesLeftInCurrentTask == 0 ) {
-		// no current message / task to complete
-		// -> get task & length from buffer
-		retrieveMessageLengthAndType();
+	if ( dispatching ) {
+		// messages passed to recipient refer to buffer: new data is taken after them
+		pendingBytes->append( bytes );
+		return;
 	}
-
-	// if there is no success: abort
-	if ( currentMessageTask == TOM_NOP ) {
-		bytesLeftInCurrentTask = 0;
-		return;	// just to be sure
+	dispatching = true;
+	receiveBytes( bytes );
+	while ( !pendingBytes->isEmpty() ) {
+		QByteArray moreBytes = *pendingBytes;
+		pendingBytes->clear();
+		receiveBytes( moreBytes );
 	}
-	// now we have some bytes in buffer and we should know about type of message
-	//   size of message + header smaller or equal buffer size
-	while ( currentMessageTask != TOM_NOP && (bytesLeftInCurrentTask + 6) <= internalBuffer->size() ) {
-		int buffSize = internalBuffer->size();
+	dispatching = false;
+}
 
-		// send complete message but without header to ConnectionController/recipient
-		QByteArray message = internalBuffer->mid( 6, bytesLeftInCurrentTask );
-
-		recipientForData->receiveData( currentMessageTask, message );
-
-		// Erase all data from buffer and reset status if there is nothing left in buffer
-		// -> buffer contains only current task data and nothing more
-		if ( bytesLeftInCurrentTask + 6 == buffSize ) {
-			currentMessageTask = TOM_NOP;
-			bytesLeftInCurrentTask = 0;
-			internalBuffer->clear();
-			// finished
-		} else {
-			// there is still data in buffer:
-			// -> copy remaining data to front of buffer
-			int startPos = bytesLeftInCurrentTask + 6;
-			for ( int i = startPos, j = 0; i < buffSize; i++, j++ )
-				(*internalBuffer)[j] = (*internalBuffer)[i];
-
-			internalBuffer->chop( startPos );	// truncate buffer after current stored data
-
-			// Sanity check and strange error correction
-			if ( internalBuffer->size() <= 2 ) {
-				logger->warn(QString("ControlMessageBuffer - dropping %1 bytes in buffer").arg( QString::number(buffSize)));
-				currentMessageTask = TOM_NOP;
-				bytesLeftInCurrentTask = 0;
-				internalBuffer->clear();
-			} else {
-				retrieveMessageLengthAndType();
-			}
-		}
-	}
+void ControlMessageBuffer::reset() {
+	pendingBytes->clear();
+	if ( dispatching )
+		// buffer is in use by message passed to recipient: cleared afterwards
+		resetRequested = true;
+	else
+		internalBuffer->clear();
 }
 
-void ControlMessageBuffer::retrieveMessageLengthAndType() {
-	currentMessageTask = getTypeOfMessage( *internalBuffer );
-	if ( currentMessageTask == TOM_NOP ) {
-		// Ohoh... there is probably nonsense data in buffer or synchronization lost
-		if ( internalBuffer->size() < 7 ) {
-			logger->warn( QString("ControlMessageBuffer: Sync lost or unknown type of message from network: (len < 7)") );
-		} else {
-			logger->warn( QString::fromAscii("ControlMessageBuffer: Sync lost or unknown type of message from network: %1").arg(
-					messageToString( (*internalBuffer), 7 ) ) );
+void ControlMessageBuffer::receiveBytes( const QByteArray & bytes ) {
+	if ( internalBuffer->isEmpty() ) {
+		// nothing left from last read: messages are taken from read data directly
+		int used = dispatchMessages( bytes.constData(), bytes.size() );
+		if ( resetRequested ) {
+			resetRequested = false;
+			return;
 		}
+		if ( used < bytes.size() )
+			internalBuffer->append( bytes.constData() + used, bytes.size() - used );
+		return;
+	}
+	// message is split over reads
+	internalBuffer->append( bytes );
+	int used = dispatchMessages( internalBuffer->constData(), internalBuffer->size() );
+	if ( resetRequested ) {
+		resetRequested = false;
 		internalBuffer->clear();
 		return;
 	}
-	bytesLeftInCurrentTask = getLengthOfMessage( *internalBuffer );
-	if ( bytesLeftInCurrentTask < 0 ) {
-		bytesLeftInCurrentTask = 0;
-		currentMessageTask = TOM_NOP;
-		return; // try again with some more content
+	// only incomplete message at end of buffer is kept (moved once per read)
+	if ( used == internalBuffer->size() )
+		internalBuffer->clear();
+	else if ( used > 0 )
+		internalBuffer->remove( 0, used );
+}
+
+int ControlMessageBuffer::dispatchMessages( const char * data, int length ) {
+	int pos = 0;
+	while ( length - pos >= CONTROL_MESSAGE_HEADER_LEN ) {
+		eTypeOfMessage type = getTypeOfMessage( data + pos );
+		if ( type == TOM_NOP ) {
+			// Ohoh... there is probably nonsense data in buffer or synchronization lost
+			logger->warn( QString::fromAscii("ControlMessageBuffer: Sync lost or unknown type of message from network: %1").arg(
+					messageToString( QByteArray::fromRawData( data + pos, length - pos ), 7 ) ) );
+			return length;
+		}
+		int messageLength = getLengthOfMessage( data + pos );
+		if ( length - pos - CONTROL_MESSAGE_HEADER_LEN < messageLength )
+			break;	// wait for rest of message
+
+		// send complete message but without header to ConnectionController/recipient
+		QByteArray message = QByteArray::fromRawData( data + pos + CONTROL_MESSAGE_HEADER_LEN, messageLength );
+		recipientForData->receiveData( type, message );
+		// connection was closed meanwhile: remaining messages are outdated
+		if ( resetRequested )
+			return length;
+		pos += CONTROL_MESSAGE_HEADER_LEN + messageLength;
 	}
+	return pos;
 }
 
-ControlMessageBuffer::eTypeOfMessage ControlMessageBuffer::getTypeOfMessage( const QByteArray & bytes ) {
-	if ( bytes.size() < 4 ) return TOM_NOP;
+ControlMessageBuffer::eTypeOfMessage ControlMessageBuffer::getTypeOfMessage( const char * header ) {
 	// First 2 bytes are always: 0x77 0x77  OR  0x66 0x66
 	// 0x66 -> "request"
 	// 0x77 -> "answer"
-	uint8_t byte  = bytes[0];
+	uint8_t byte  = header[0];
 	if ( byte != 0x77 && byte != 0x66 ) return TOM_NOP;
-	byte  = bytes[1];
+	byte  = header[1];
 	if ( byte != 0x77 && byte != 0x66 ) return TOM_NOP;
 	// Next byte is type of message
-	byte  = bytes[2];
+	byte  = header[2];
 	switch ( byte ) {
 	case 0x65:
 		return TOM_SERVERINFO;
@@ -150,17 +135,14 @@ ControlMessageBuffer::eTypeOfMessage ControlMessageBuffer::getTypeOfMessage( con
 	return TOM_NOP;
 }
 
-int ControlMessageBuffer::getLengthOfMessage( const QByteArray & bytes ) {
-	// PRE: header is correct!
-
-	// if less than 6 bytes in buffer we cannot determine anything here!
-	if ( bytes.size() < 6 ) return -1;
+int ControlMessageBuffer::getLengthOfMessage( const char * header ) {
+	// PRE: header is correct and complete!
 
 	// unclear if byte 3 belongs to length... (never seen anything different)
 	// By now: byte 3, 4 and 5 are giving the total length of the message
-	uint8_t lenbyte0  = bytes[3];
-	uint8_t lenbyte1  = bytes[4];
-	uint8_t lenbyte2  = bytes[5];
+	uint8_t lenbyte0  = header[3];
+	uint8_t lenbyte1  = header[4];
+	uint8_t lenbyte2  = header[5];
 
 	int retVal = (lenbyte0 << 16);
 	retVal |= (lenbyte1 << 8);
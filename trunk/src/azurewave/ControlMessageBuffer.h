@@ -12,6 +12,8 @@
 #include <QString>
 
 #define DEFAULT_BUFFER_SIZE (1024 * 64)
+/** Length of message header: 2 bytes 0x66/0x77, type of message, 3 bytes length of message */
+#define CONTROL_MESSAGE_HEADER_LEN	6
 
 class HubDevice;
 class QByteArray;
@@ -34,19 +36,37 @@ public:
 	~ControlMessageBuffer();
 
 	/**
-	 * Receive bytes read from network and add to internal buffering.
+	 * Receive bytes read from network and add to internal buffering.<br>
+	 * Every complete message is passed to recipient. NOTE: Message data is not copied - it is
+	 * valid during call of recipient only.
 	 */
 	void receive( const QByteArray & bytes );
+	/**
+	 * Drops incomplete message and bytes not processed until now (e.g. connection was closed).
+	 * If called while a message is passed to recipient, remaining messages are dropped after it.
+	 */
+	void reset();
 private:
 	Logger * logger;
 	HubDevice * recipientForData;
+	/** Incomplete message (remaining bytes of last reads) */
 	QByteArray * internalBuffer;
-	int bytesLeftInCurrentTask;
-	eTypeOfMessage currentMessageTask;
+	/** Messages are being passed to recipient */
+	bool dispatching;
+	/** Bytes received while messages are passed to recipient (e.g. in event loop of a dialog) */
+	QByteArray * pendingBytes;
+	/** Buffer was reset while messages were passed to recipient */
+	bool resetRequested;
+
+	void receiveBytes( const QByteArray & bytes );
 
-	eTypeOfMessage getTypeOfMessage( const QByteArray & bytes );
-	int getLengthOfMessage( const QByteArray & bytes );
-	void retrieveMessageLengthAndType();
+	/**
+	 * Passes all complete messages of data to recipient.
+	 * @return	Number of bytes used (messages passed or nonsense data dropped)
+	 */
+	int dispatchMessages( const char * data, int length );
+	eTypeOfMessage getTypeOfMessage( const char * header );
+	int getLengthOfMessage( const char * header );
 	QString messageToString( const QByteArray & bytes, int lengthToPrint = 6 );
 	QString typeOfMessageToString( ControlMessageBuffer::eTypeOfMessage type );
 };
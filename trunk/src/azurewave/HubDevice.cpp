@@ -7,7 +7,7 @@
  */
 
 #include "HubDevice.h"
-#include "XMLmessageDOMparser.h"
+#include "XMLmessageStreamParser.h"
 #include "ConnectionController.h"
 #include "WusbStack.h"
 #include "../TI_WusbStack.h"
@@ -28,6 +28,7 @@
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <time.h>
+#include <unistd.h>
 
 
 HubDevice::HubDevice( const QHostAddress & address, ConnectionController * controller, int devNumber ) {
@@ -56,8 +57,28 @@ HubDevice::HubDevice( const QHostAddress & address, ConnectionController * contr
 
 	controlConnectionPortNum = DEFAULT_DEVICE_CONTROL_PORT;	// TODO port number configurable?!
 	aliveTimerInterval = DEFAULT_DEVICE_CONTROL_ALIVE_INTERVAL;	// TODO alive timer interval configurable!
+	reconnectDelayMillis = ConfigManager::getInstance().getIntValue(
+			"azurewave.devctrl.reconnectDelay", DEFAULT_DEVICE_CONTROL_RECONNECT_DELAY );
+	maxReconnectDelayMillis = ConfigManager::getInstance().getIntValue(
+			"azurewave.devctrl.maxReconnectDelay", DEFAULT_DEVICE_CONTROL_MAX_RECONNECT_DELAY );
+	if ( reconnectDelayMillis < 1 ) reconnectDelayMillis = 1;
+	if ( maxReconnectDelayMillis < reconnectDelayMillis ) maxReconnectDelayMillis = reconnectDelayMillis;
+	reconnectAttempts = 0;
 	receiveBuffer = new ControlMessageBuffer( this );
 
+	// jitter of reconnects: hubs (and hosts) should not retry in lockstep
+	static bool randomSeeded = false;
+	if ( !randomSeeded ) {
+		qsrand( (uint) time(0) ^ (uint) getpid() );
+		randomSeeded = true;
+	}
+	connectTimer = new QTimer( this );
+	connectTimer->setSingleShot( true );
+	connect( connectTimer, SIGNAL(timeout()), this, SLOT(controlConnectionTimeout()) );
+	reconnectTimer = new QTimer( this );
+	reconnectTimer->setSingleShot( true );
+	connect( reconnectTimer, SIGNAL(timeout()), this, SLOT(reconnectControlConnection()) );
+
 	for ( int i = 0; i < 10; i++ ) {
 		deviceList.append( new USBTechDevice(this) );
 		deviceList[i]->isValid = false;
@@ -65,19 +86,16 @@ HubDevice::HubDevice( const QHostAddress & address, ConnectionController * contr
 		deviceList[i]->visualTreeWidgetItem = NULL;
 	}
 
-	// open TCP control connection and get device information
-	if ( ! openControlConnection( controlConnectionPortNum ) ) {
-		alive = false;
-		controlConnectionSocket = NULL;
-	} else if ( queryDeviceInfo() ) {
-		alive = true;
-		startAliveTimer();
-	}
+	// open TCP control connection - device information is requested when connection is established
+	openControlConnection();
+	startAliveTimer();
 }
 
 HubDevice::~HubDevice() {
 	if ( aliveTimer )
 		aliveTimer->stop();
+	connectTimer->stop();
+	reconnectTimer->stop();
 	if ( controlConnectionSocket ) {
 		controlConnectionSocket->abort();
 		controlConnectionSocket->close();
@@ -88,11 +106,10 @@ Logger * HubDevice::getLogger() {
 	return logger;
 }
 
-TI_WusbStack * HubDevice::createStackForDevice( const QString & deviceID ) {
-	USBTechDevice & deviceRef = findDeviceByID( deviceID );
-	if ( deviceRef.isValid ) {
-		Logger * logger = Logger::getLogger( QString("USBConn") + QString::number( deviceRef.portNum ) );
-		return new WusbStack( logger, QHostAddress(ipAddress), deviceRef.connectionPortNum );
+TI_WusbStack * HubDevice::createStackForDevice( const USBTechDevice * deviceRef ) {
+	if ( deviceRef ) {
+		Logger * logger = Logger::getLogger( QString("USBConn") + QString::number( deviceRef->portNum ) );
+		return new WusbStack( logger, QHostAddress(ipAddress), deviceRef->connectionPortNum );
 	} else
 		return NULL;
 }
@@ -100,7 +117,7 @@ TI_WusbStack * HubDevice::createStackForDevice( const QString & deviceID ) {
 
 
 void HubDevice::setXMLdiscoveryData( int len, const QByteArray & payloadData ) {
-	ControlMsg_DiscoveryResponse *parseResult = XMLmessageDOMparser::parseDiscoveryMessage( payloadData );
+	ControlMsg_DiscoveryResponse *parseResult = XMLmessageStreamParser::parseDiscoveryMessage( payloadData );
 	if ( parseResult ) {
 		name = parseResult->name;
 		delete parseResult;
@@ -120,17 +137,83 @@ void HubDevice::startAliveTimer() {
 	aliveTimer->start( aliveTimerInterval );
 }
 
-bool HubDevice::openControlConnection( int portNum ) {
+void HubDevice::openControlConnection() {
 	controlConnectionSocket = new QTcpSocket( this );
 	controlConnectionSocket->setSocketOption( QAbstractSocket::LowDelayOption, 1 );
+	connectionState = CCS_CONNECTING;
 
-	logger->info( QString::fromAscii("Hub device: Open control connection to %1:%2").arg( ipAddress.toString(), QString::number(portNum) ) );
-	controlConnectionSocket->connectToHost( ipAddress, portNum );
+	logger->info( QString::fromAscii("Hub device: Open control connection to %1:%2").arg(
+			ipAddress.toString(), QString::number(controlConnectionPortNum) ) );
+	connect(controlConnectionSocket, SIGNAL(connected()), this, SLOT(controlConnectionEstablished()));
 	connect(controlConnectionSocket, SIGNAL(readyRead()), this, SLOT(readControlConnectionMessage()));
 	connect(controlConnectionSocket, SIGNAL(error(QAbstractSocket::SocketError)),
 			this, SLOT(notifyControlConnectionError(QAbstractSocket::SocketError)));
+	controlConnectionSocket->connectToHost( ipAddress, controlConnectionPortNum );
+	connectTimer->start( DEFAULT_DEVICE_CONTROL_CONNECT_TIMEOUT );
+}
 
-	return controlConnectionSocket->waitForConnected( 1500 );
+void HubDevice::controlConnectionEstablished() {
+	connectTimer->stop();
+	connectionState = CCS_CONNECTED;
+	if ( reconnectAttempts > 0 )
+		logger->warn( QString("Reconnect sucess after %1 tries!").arg( QString::number(reconnectAttempts) ) );
+	reconnectAttempts = 0;
+	lastSeenTimestamp = time(0);
+	if ( queryDeviceInfo() )
+		alive = true;
+	importHeldDevices();
+}
+
+void HubDevice::controlConnectionTimeout() {
+	if ( connectionState != CCS_CONNECTING ) return;
+	logger->warn( QString("Control connection to hub not established within %1 ms").arg(
+			QString::number(DEFAULT_DEVICE_CONTROL_CONNECT_TIMEOUT) ) );
+	closeControlConnection();
+}
+
+void HubDevice::closeControlConnection() {
+	connectTimer->stop();
+	alive = false;
+	if ( controlConnectionSocket ) {
+		disconnect( controlConnectionSocket, SIGNAL(connected()), this, SLOT(controlConnectionEstablished()) );
+		disconnect( controlConnectionSocket, SIGNAL(readyRead()), this, SLOT(readControlConnectionMessage()) );
+		disconnect(controlConnectionSocket, SIGNAL(error(QAbstractSocket::SocketError)),
+				this, SLOT(notifyControlConnectionError(QAbstractSocket::SocketError)));
+		controlConnectionSocket->abort();
+		controlConnectionSocket->close();
+		// socket may be emitting this error right now
+		controlConnectionSocket->deleteLater();
+		controlConnectionSocket = NULL;
+	}
+	// partial message of dropped connection must not be taken as start of new connection
+	receiveBuffer->reset();
+	errorCounter++;
+	// hub may be unreachable for a moment only: connected devices are kept and reconnected
+	holdConnectedDevices();
+	scheduleReconnect();
+}
+
+void HubDevice::scheduleReconnect() {
+	int delay = reconnectDelayMillis;
+	for ( int i = 0; i < reconnectAttempts && delay < maxReconnectDelayMillis; i++ )
+		delay *= 2;
+	if ( delay > maxReconnectDelayMillis ) delay = maxReconnectDelayMillis;
+	// random jitter: +/- 25%
+	int jitter = delay / 4;
+	if ( jitter > 0 )
+		delay += ( qrand() % ( 2 * jitter + 1 ) ) - jitter;
+	reconnectAttempts++;
+	connectionState = CCS_WAITING;
+	if ( logger->isInfoEnabled() )
+		logger->info( QString("Connection to hub lost - trying reconnect in %1 ms (%2. try)").arg(
+				QString::number(delay), QString::number(reconnectAttempts) ) );
+	reconnectTimer->start( delay );
+}
+
+void HubDevice::reconnectControlConnection() {
+	if ( connectionState != CCS_WAITING ) return;
+	disconnectExpiredDevices();
+	openControlConnection();
 }
 
 
@@ -196,6 +279,8 @@ void HubDevice::readControlConnectionMessage() {
 
 
 	QByteArray bytesRead = controlConnectionSocket->readAll();
+	// hub is alive - even if messages are not processed now (see ControlMessageBuffer::receive)
+	lastSeenTimestamp = time(0);
 	receiveBuffer->receive( bytesRead );
 }
 
@@ -216,31 +301,38 @@ void HubDevice::receiveData( ControlMessageBuffer::eTypeOfMessage type, const QB
 		}
 		break;
 	case ControlMessageBuffer::TOM_SERVERINFO:
+	{
 		lastSeenTimestamp = time(0);
-		XMLmessageDOMparser::parseServerInfoMessage( bytes, this );
-		refController->drawVisualTree();
+		QList<ControlMsg_DeviceDelta> deltas = XMLmessageStreamParser::parseServerInfoMessage( bytes, this );
+		updateDeviceIndex( deltas );
+		applyDeviceDeltas( deltas );
 		break;
+	}
 	case ControlMessageBuffer::TOM_IMPORTINFO:
 	{
 		// Answer to an "import" request
 		lastSeenTimestamp = time(0);
-		USBTechDevice & usedDevice = XMLmessageDOMparser::parseImportResponseMessage( bytes, this );
-		if ( usedDevice.isValid ) {
+		USBTechDevice * usedDevice = XMLmessageStreamParser::parseImportResponseMessage( bytes, this );
+		if ( usedDevice ) {
 			if ( logger->isDebugEnabled() )
 				logger->debug( QString::fromAscii("ImportInfo for device: %1 - Result: %2 - ConnectingToPort: %3").arg(
-						usedDevice.deviceID,
-						QString::number(usedDevice.lastOperationErrorCode),
-						QString::number(usedDevice.connectionPortNum) ) );
+						usedDevice->deviceID,
+						QString::number(usedDevice->lastOperationErrorCode),
+						QString::number(usedDevice->connectionPortNum) ) );
 
-			switch ( usedDevice.nextJobID ) {
+			switch ( usedDevice->nextJobID ) {
 			case USBTechDevice::JA_INTERNAL_QUERY_DEVICE:
 				// device query operation
-				queryDeviceJob( usedDevice );
+				queryDeviceJob( *usedDevice );
 				break;
 
 			case USBTechDevice::JA_CONNECT_DEVICE:
 				// connect to virtual USB port
-				connectDeviceJob( usedDevice );
+				connectDeviceJob( *usedDevice );
+				break;
+			case USBTechDevice::JA_RECONNECT_DEVICE:
+				// device is still connected to virtual USB port
+				reconnectDeviceJob( *usedDevice );
 				break;
 			case USBTechDevice::JA_NONE:
 				// doing virtually nothing - keeps the compiler happy
@@ -257,7 +349,7 @@ void HubDevice::receiveData( ControlMessageBuffer::eTypeOfMessage type, const QB
 		// -> Receive of this message should pop up a message box
 		lastSeenTimestamp = time(0);
 		if ( bytes.length() > 10 ) {
-			ControlMsg_UnimportRequest * unimportMsg = XMLmessageDOMparser::parseUnimportMessage( bytes );
+			ControlMsg_UnimportRequest * unimportMsg = XMLmessageStreamParser::parseUnimportMessage( bytes );
 			if ( unimportMsg ) {
 				if ( logger->isDebugEnabled() )
 					logger->debug( QString("UnImportInfo from host: %1 for device %2").
@@ -272,11 +364,18 @@ void HubDevice::receiveData( ControlMessageBuffer::eTypeOfMessage type, const QB
 	case ControlMessageBuffer::TOM_STATUSCHANGED:
 	{
 		lastSeenTimestamp = time(0);
-		QStringList sl = XMLmessageDOMparser::parseStatusChangedMessage( bytes, this );
+		QList<ControlMsg_DeviceDelta> deltas = XMLmessageStreamParser::parseStatusChangedMessage( bytes, this );
+		QStringList sl;
+		for ( int i = 0; i < deltas.size(); i++ ) {
+			sl.append( deltas[i].deviceID );
+			// description of a new device is part of server info only
+			if ( deltas[i].type == ControlMsg_DeviceDelta::DD_UNKNOWN_DEVICE )
+				wantServerInfoRequest = true;
+		}
 		if ( logger->isDebugEnabled() )
 			logger->debug( QString::fromAscii("Status changed for device(s): %1").arg( sl.join(", ") ) );
-		refreshAllWidgetItemForDevice();
-		wantServerInfoRequest = true;
+		updateDeviceIndex( deltas );
+		applyDeviceDeltas( deltas );
 		break;
 	}	// keeps the compiler happy...
 	case ControlMessageBuffer::TOM_MSG66:
@@ -289,18 +388,46 @@ void HubDevice::receiveData( ControlMessageBuffer::eTypeOfMessage type, const QB
 
 
 void HubDevice::notifyControlConnectionError( QAbstractSocket::SocketError socketError ) {
-//	aliveTimer->stop();
-	alive = false;
-	if ( controlConnectionSocket ) {
-		logger->warn(QString::fromLatin1("SocketError: %1").arg(controlConnectionSocket->errorString()) );
-		disconnect( controlConnectionSocket, SIGNAL(readyRead()), this, SLOT(readControlConnectionMessage()) );
-		disconnect(controlConnectionSocket, SIGNAL(error(QAbstractSocket::SocketError)),
-				this, SLOT(notifyControlConnectionError(QAbstractSocket::SocketError)));
-		controlConnectionSocket->abort();
-		controlConnectionSocket->close();
+	if ( !controlConnectionSocket ) return;
+	logger->warn(QString::fromLatin1("SocketError: %1").arg(controlConnectionSocket->errorString()) );
+	closeControlConnection();
+}
 
-		controlConnectionSocket = NULL;
-		errorCounter++;
+void HubDevice::holdConnectedDevices() {
+	for ( int i = 0; i < deviceList.size(); i++ ) {
+		USBTechDevice * deviceRef = deviceList[i];
+		if ( !deviceRef->isValid || !deviceRef->owned || !deviceRef->connWorker ||
+				deviceRef->connWorker->getLastExitCode() != USBconnectionWorker::WORK_DONE_STILL_RUNNING ||
+				deviceRef->nextJobID == USBTechDevice::JA_RECONNECT_DEVICE )
+			continue;
+		if ( deviceRef->connWorker->holdDevice() ) {
+			logger->info( QString("Device %1 is held until hub is reachable again").arg( deviceRef->deviceID ) );
+			deviceRef->nextJobID = USBTechDevice::JA_RECONNECT_DEVICE;
+		}
+	}
+}
+
+void HubDevice::importHeldDevices() {
+	for ( int i = 0; i < deviceList.size(); i++ ) {
+		USBTechDevice * deviceRef = deviceList[i];
+		if ( deviceRef->nextJobID != USBTechDevice::JA_RECONNECT_DEVICE ) continue;
+		if ( logger->isInfoEnabled() )
+			logger->info( QString("Importing held device %1 again").arg( deviceRef->deviceID ) );
+		sendImportDeviceMessage( deviceRef->deviceID,
+				QString::number(deviceRef->idVendor, 16),
+				QString::number(deviceRef->idProduct, 16) );
+	}
+}
+
+void HubDevice::disconnectExpiredDevices() {
+	for ( int i = 0; i < deviceList.size(); i++ ) {
+		USBTechDevice * deviceRef = deviceList[i];
+		if ( deviceRef->nextJobID != USBTechDevice::JA_RECONNECT_DEVICE ) continue;
+		if ( deviceRef->connWorker && !deviceRef->connWorker->isHoldExpired() ) continue;
+		logger->warn( QString("Held device %1 not reconnected in time").arg( deviceRef->deviceID ) );
+		if ( deviceRef->connWorker )
+			deviceRef->connWorker->disconnectDevice();
+		deviceRef->nextJobID = USBTechDevice::JA_NONE;
 	}
 }
 
@@ -458,18 +585,15 @@ bool HubDevice::isAlive() {
 }
 
 void HubDevice::sendAliveRequest() {
-	if ( !controlConnectionSocket || !controlConnectionSocket->isOpen() ) {
-		if ( errorCounter > 3 )
-			return;
-		else {
-			logger->warn( QString("Connection to hub lost - trying reconnect... (error counter = %1)").arg(
-					QString::number(errorCounter) ) );
-			if ( !openControlConnection( controlConnectionPortNum ) ) {
-				logger->warn( QString("Reconnect failed (%1. try)").arg( QString::number(errorCounter) ) );
-				return;
-			}
-			logger->warn( "Reconnect sucess!" );
-		}
+	disconnectExpiredDevices();
+	// (re)connect is done by timers of connection
+	if ( connectionState != CCS_CONNECTED || !controlConnectionSocket )
+		return;
+	// connection may be dead without any error (e.g. hub or host changed network)
+	if ( time(0) - lastSeenTimestamp > ( DEFAULT_DEVICE_CONTROL_ALIVE_TIMEOUT * aliveTimerInterval ) / 1000 ) {
+		logger->warn( QString("No answer from hub since %1 s").arg( QString::number( time(0) - lastSeenTimestamp ) ) );
+		closeControlConnection();
+		return;
 	}
 	if ( logger->isTraceEnabled() )
 		logger->trace(QString("Sending control connection alive request to hub... (%1)").arg( ipAddress.toString() ));
@@ -490,20 +614,34 @@ void HubDevice::sendAliveRequest() {
 	}
 }
 
-USBTechDevice & HubDevice::findDeviceByID( const QString & deviceID ) {
-//	LogWriter::info(QString("findDeviceByID: '%1'").arg( deviceID ));
-	QListIterator<USBTechDevice*> it( deviceList );
-	int idx = -1;
+USBTechDevice * HubDevice::findDeviceByID( const QString & deviceID ) {
+	uint key;
+	if ( !deviceIDKey( deviceID, key ) ) return NULL;
+	USBTechDevice * usbDev = deviceIndex.value( key, NULL );
+	// device may be invalidated by a message which is not applied to index yet
+	if ( usbDev && !usbDev->isValid ) return NULL;
+	return usbDev;
+}
+
+bool HubDevice::deviceIDKey( const QString & deviceID, uint & key ) {
+	bool convOk = false;
+	key = deviceID.trimmed().toUInt( &convOk, 16 );
+	return convOk;
+}
+
+void HubDevice::updateDeviceIndex( const QList<ControlMsg_DeviceDelta> & deltas ) {
+	QListIterator<ControlMsg_DeviceDelta> it( deltas );
 	while ( it.hasNext() ) {
-		USBTechDevice * usbDev = it.next();
-		idx++;
-		if ( usbDev->isValid && !usbDev->deviceID.isNull() && usbDev->deviceID.compare( deviceID, Qt::CaseInsensitive ) == 0 ) {
-			return *(deviceList[idx]);
-		}
+		const ControlMsg_DeviceDelta & delta = it.next();
+		uint key;
+		if ( !deviceIDKey( delta.deviceID, key ) ) continue;
+		if ( delta.type == ControlMsg_DeviceDelta::DD_REMOVED ) {
+			// same slot may have been taken by another device meanwhile
+			if ( deviceIndex.value( key, NULL ) == delta.device )
+				deviceIndex.remove( key );
+		} else if ( delta.type == ControlMsg_DeviceDelta::DD_ADDED )
+			deviceIndex.insert( key, delta.device );
 	}
-	USBTechDevice * fooDev = new USBTechDevice( this );
-	fooDev->isValid = false;
-	return *fooDev;
 }
 
 QString HubDevice::toString() {
@@ -606,21 +744,60 @@ QTreeWidgetItem * HubDevice::getQTreeWidgetItemForDevice( USBTechDevice & usbDev
 	return usbDevice.visualTreeWidgetItem;
 }
 
-void HubDevice::refreshAllWidgetItemForDevice() {
-	QList<USBTechDevice*>::iterator it;
-	for ( it = deviceList.begin(); it != deviceList.end(); ++it ) {
-		USBTechDevice * usbDev = (*it);
-
-		if ( usbDev->isValid ) {
-			logger->debug( QString("Refresh item for USBdev: %1").arg(usbDev->deviceID) );
-			getQTreeWidgetItemForDevice( *usbDev );
-		} else if ( usbDev->visualTreeWidgetItem ) {
-			logger->debug("Setting hidden flag for USBdev");
-			usbDev->visualTreeWidgetItem->setHidden( true );
+void HubDevice::applyDeviceDeltas( const QList<ControlMsg_DeviceDelta> & deltas ) {
+	if ( !visualTreeWidgetItem ) {
+		// hub is not drawn yet
+		refController->drawVisualTree();
+		return;
+	}
+	setToolTipText();
+	QListIterator<ControlMsg_DeviceDelta> it( deltas );
+	while ( it.hasNext() ) {
+		const ControlMsg_DeviceDelta & delta = it.next();
+		switch ( delta.type ) {
+		case ControlMsg_DeviceDelta::DD_ADDED:
+			if ( logger->isDebugEnabled() )
+				logger->debug( QString("Adding item for USBdev: %1").arg( delta.deviceID ) );
+			attachDeviceWidgetItem( *delta.device );
+			break;
+		case ControlMsg_DeviceDelta::DD_REMOVED:
+			if ( logger->isDebugEnabled() )
+				logger->debug( QString("Removing item for USBdev: %1").arg( delta.deviceID ) );
+			detachDeviceWidgetItem( *delta.device );
+			break;
+		case ControlMsg_DeviceDelta::DD_CLAIM_CHANGED:
+			if ( logger->isDebugEnabled() )
+				logger->debug( QString("Refresh item for USBdev: %1").arg( delta.deviceID ) );
+			getQTreeWidgetItemForDevice( *delta.device );
+			break;
+		case ControlMsg_DeviceDelta::DD_UNCHANGED:
+		case ControlMsg_DeviceDelta::DD_UNKNOWN_DEVICE:
+			break;
 		}
 	}
 }
 
+void HubDevice::attachDeviceWidgetItem( USBTechDevice & usbDevice ) {
+	QTreeWidgetItem * item = getQTreeWidgetItemForDevice( usbDevice );
+	if ( item->parent() == visualTreeWidgetItem ) return;
+	// keep order of ports
+	int index = 0;
+	while ( index < visualTreeWidgetItem->childCount() ) {
+		USBTechDevice * childDevice = visualTreeWidgetItem->child( index )->data(0, Qt::UserRole).value<USBTechDevice*>();
+		if ( childDevice && childDevice->sortNumber > usbDevice.sortNumber ) break;
+		index++;
+	}
+	visualTreeWidgetItem->insertChild( index, item );
+}
+
+void HubDevice::detachDeviceWidgetItem( USBTechDevice & usbDevice ) {
+	if ( !usbDevice.visualTreeWidgetItem ) return;
+	// item is kept for reuse (see getQTreeWidgetItem)
+	if ( usbDevice.visualTreeWidgetItem->parent() == visualTreeWidgetItem )
+		visualTreeWidgetItem->removeChild( usbDevice.visualTreeWidgetItem );
+	usbDevice.visualTreeWidgetItem->setHidden( true );
+}
+
 void HubDevice::setToolTipText() {
 	visualTreeWidgetItem->setToolTip( 0,
 			tr("<html><b>Device: <em>%1</em></b><br>"
@@ -781,6 +958,17 @@ void HubDevice::connectDeviceJob( USBTechDevice & deviceRef ) {
 	deviceRef.nextJobID = USBTechDevice::JA_NONE;
 }
 
+void HubDevice::reconnectDeviceJob( USBTechDevice & deviceRef ) {
+	deviceRef.nextJobID = USBTechDevice::JA_NONE;
+	if ( !deviceRef.connWorker ) return;
+	if ( deviceRef.lastOperationErrorCode != 0 ) {
+		logger->warn( QString("Held device %1 could not be imported again - disconnecting").arg( deviceRef.deviceID ) );
+		deviceRef.connWorker->disconnectDevice();
+		return;
+	}
+	deviceRef.connWorker->reconnectDevice();
+}
+
 void HubDevice::disconnectDevice( USBTechDevice * deviceRef ) {
 	if ( ! deviceRef ) return;
 	if ( ! deviceRef->isValid || deviceRef->status != USBTechDevice::PS_Claimed ) {
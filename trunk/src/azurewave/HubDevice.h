@@ -13,11 +13,20 @@
 #include "ControlMessageBuffer.h"
 #include "../USBconnectionWorker.h"
 #include <QObject>
+#include <QHash>
 #include <QTcpSocket>
 #include <QHostAddress>
 
 #define DEFAULT_DEVICE_CONTROL_PORT				21827
 #define DEFAULT_DEVICE_CONTROL_ALIVE_INTERVAL	3000
+/** Delay (ms) of first reconnect of control connection after an error (devices are held meanwhile) */
+#define DEFAULT_DEVICE_CONTROL_RECONNECT_DELAY	250
+/** Max. delay (ms) between reconnects - delay is doubled after every failed try up to this value */
+#define DEFAULT_DEVICE_CONTROL_MAX_RECONNECT_DELAY	30000
+/** Time (ms) to wait for establishment of control connection */
+#define DEFAULT_DEVICE_CONTROL_CONNECT_TIMEOUT	1500
+/** Number of alive intervals without any message from hub after which connection is considered dead */
+#define DEFAULT_DEVICE_CONTROL_ALIVE_TIMEOUT	4
 
 class QTimer;
 class QByteArray;
@@ -46,13 +55,35 @@ struct ControlMsg_UnimportRequest {
 	QString message;
 };
 
+/**
+ * Change of one device on hub (result of messages <tt>getServerInfoResponse</tt> and
+ * <tt>devStatusChanged</tt>) - only changed devices have to be redrawn.
+ */
+struct ControlMsg_DeviceDelta {
+	enum eDeltaType {
+		/** Device is new on its port (or replaces another device) */
+		DD_ADDED,
+		/** Device is gone (unplugged or not reported anymore) */
+		DD_REMOVED,
+		/** Status or owner of device changed */
+		DD_CLAIM_CHANGED,
+		DD_UNCHANGED,
+		/** Status of a device which is not known yet: server info is needed */
+		DD_UNKNOWN_DEVICE
+	};
+	eDeltaType type;
+	QString deviceID;
+	/** Device slot on hub (<tt>NULL</tt> for <tt>DD_UNKNOWN_DEVICE</tt>) */
+	USBTechDevice * device;
+};
+
 
 /**
  * Represents one network usb hub device.
  */
 class HubDevice : public TI_USBhub {
 	Q_OBJECT
-friend class XMLmessageDOMparser;
+friend class XMLmessageStreamParser;
 public:
 	HubDevice( const QHostAddress & address, ConnectionController * controller, int discoveredDeviceNumber = 0 );
 	virtual ~HubDevice();
@@ -98,9 +129,11 @@ public:
 	void connectDevice( USBTechDevice * deviceRef );
 
 	/**
-	 * Finds a specific device by given device ID.
+	 * Finds a specific (valid) device by given device ID.<br>
+	 * Thread of hub only (device index is changed by control messages without locking).
+	 * @return	Device slot of hub (stable for lifetime of hub) - <tt>NULL</tt> if device is not known
 	 */
-	USBTechDevice & findDeviceByID( const QString & deviceID );
+	USBTechDevice * findDeviceByID( const QString & deviceID );
 
 	/**
 	 * Returns reference to logger.
@@ -108,9 +141,10 @@ public:
 	Logger * getLogger();
 
 	/**
-	 * Factory method to create a WUSB stack for given device.
+	 * Factory method to create a WUSB stack for given device.<br>
+	 * Called by connection workers (other thread): device is not looked up in device index of hub.
 	 */
-	TI_WusbStack * createStackForDevice( const QString & deviceID );
+	TI_WusbStack * createStackForDevice( const USBTechDevice * deviceRef );
 
 private:
 	/** Value from discovery reply: Name of device */
@@ -129,6 +163,8 @@ private:
 	QString firmwareDate;
 	/** List of all reported / connected devices on hub */
 	QList<USBTechDevice*> deviceList;
+	/** Valid devices of <tt>deviceList</tt> by numeric device ID (see <tt>deviceIDKey</tt>) - thread of hub only */
+	QHash<uint, USBTechDevice*> deviceIndex;
 
 	/** IP address of this device in network */
 	QHostAddress ipAddress;
@@ -149,8 +185,27 @@ private:
 	/** Device number, set from constructor. [not used yet] */
 	int deviceNumber;
 
+	/** State of control connection */
+	enum eControlConnectionState {
+		CCS_CONNECTING,
+		CCS_CONNECTED,
+		/** Waiting for next try to connect */
+		CCS_WAITING
+	};
+	eControlConnectionState connectionState;
+	/** Number of failed tries to connect since last established connection */
+	int reconnectAttempts;
+	/** Configuration value: delay of first reconnect */
+	int reconnectDelayMillis;
+	/** Configuration value: max. delay between reconnects */
+	int maxReconnectDelayMillis;
+
 	/** Timer to send alive requests at regular interval (see <tt>aliveTimerInterval</tt>) */
 	QTimer *aliveTimer;
+	/** Timer: establishment of control connection takes too long */
+	QTimer *connectTimer;
+	/** Timer: next try to connect */
+	QTimer *reconnectTimer;
 	/** control connection socket */
 	QTcpSocket *controlConnectionSocket;
 	/** Reference to receive buffer */
@@ -172,21 +227,45 @@ private:
 	 * Send "unimport" message to hub to request release of device by other host.
 	 */
 	bool sendUnimportMessage( const QString & deviceID, const QString & message );
-	bool openControlConnection( int portNum );
+	/** Starts to connect control connection (does not block - see <tt>controlConnectionEstablished</tt>) */
+	void openControlConnection();
+	/** Drops control connection: held devices are kept and a reconnect is scheduled */
+	void closeControlConnection();
+	/** Next try to connect after exponential backoff (with random jitter) */
+	void scheduleReconnect();
 	int createClientSocket( const char *hostname, int localport, int peerport );
 	void startAliveTimer();
 
 	QTreeWidgetItem * getQTreeWidgetItemForDevice( USBTechDevice & usbDevice );
 	QString getIconResourceForDevice( USBTechDevice & usbDevice );
 	void setToolTipText();
-	void refreshAllWidgetItemForDevice();
+	/** Numeric key of device ID (hex string, case insensitive). @return <code>false</code> if ID is malformed */
+	static bool deviceIDKey( const QString & deviceID, uint & key );
+	/** Keeps index of devices in sync with changes of devices */
+	void updateDeviceIndex( const QList<ControlMsg_DeviceDelta> & deltas );
+	/** Updates tree items of changed devices only (whole hub is drawn if it has no tree item yet) */
+	void applyDeviceDeltas( const QList<ControlMsg_DeviceDelta> & deltas );
+	/** Inserts item of device into tree item of hub (ordered by port) */
+	void attachDeviceWidgetItem( USBTechDevice & usbDevice );
+	void detachDeviceWidgetItem( USBTechDevice & usbDevice );
 
 	void queryDeviceJob(USBTechDevice & deviceRef);
 	void connectDeviceJob( USBTechDevice & deviceRef );
+	/** Import answer for a held device: reconnect device (or disconnect it if import failed) */
+	void reconnectDeviceJob( USBTechDevice & deviceRef );
+	/** Control connection is lost: keep connected devices on their virtual ports */
+	void holdConnectedDevices();
+	/** Control connection is back: import held devices again */
+	void importHeldDevices();
+	/** Disconnect held devices whose grace period is over */
+	void disconnectExpiredDevices();
 public slots:
 	void sendAliveRequest();
 	void readControlConnectionMessage();
 	void notifyControlConnectionError(QAbstractSocket::SocketError socketError);
+	void controlConnectionEstablished();
+	void controlConnectionTimeout();
+	void reconnectControlConnection();
 	void connectionWorkerJobDone( USBconnectionWorker::eWorkDoneExitCode, USBTechDevice* );
 	/**
 	 * Handle reply from user to question/info.
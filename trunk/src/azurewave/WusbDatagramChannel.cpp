@@ -0,0 +1,256 @@
+/*
+ * WusbDatagramChannel.cpp
+ *
+ * @author:		Sebastian Kolbe-Nusser &lt;Sebastian DOT Kolbe AT gmail DOT com&gt;
+ * @version:	$Id$
+ * @created:	2011-04-12
+ */
+
+#include "WusbDatagramChannel.h"
+#include "../utils/Logger.h"
+#include <QHostAddress>
+#include <QAbstractSocket>
+#include <QSocketNotifier>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <arpa/inet.h>
+
+WusbDatagramChannel::WusbDatagramChannel( Logger * parentLogger, int numSlots, int slotSize, QObject * parent )
+: QObject( parent ) {
+	logger = parentLogger;
+	socketFD = -1;
+	readNotifier = NULL;
+	numQueued = 0;
+	numReceived = 0;
+	sendTooBig = false;
+	::memset( &destSockAddr, 0, sizeof(destSockAddr) );
+	::memset( sendMsgs, 0, sizeof(sendMsgs) );
+
+	if ( numSlots < 1 ) numSlots = 1;
+	if ( slotSize < 1500 ) slotSize = 1500;
+	numReceiveSlots = numSlots;
+	receiveSlotSize = slotSize;
+
+	// the receive ring is allocated once - every slot is described by its own message header
+	receiveRing = new char[ numReceiveSlots * receiveSlotSize ];
+	receiveMsgs = new struct mmsghdr[ numReceiveSlots ];
+	receiveIov  = new struct iovec[ numReceiveSlots ];
+	::memset( receiveMsgs, 0, numReceiveSlots * sizeof(struct mmsghdr) );
+	for ( int i = 0; i < numReceiveSlots; i++ ) {
+		receiveIov[i].iov_base = receiveRing + i * receiveSlotSize;
+		receiveIov[i].iov_len  = receiveSlotSize;
+		receiveMsgs[i].msg_hdr.msg_iov    = &receiveIov[i];
+		receiveMsgs[i].msg_hdr.msg_iovlen = 1;
+	}
+}
+
+WusbDatagramChannel::~WusbDatagramChannel() {
+	close();
+	delete[] receiveMsgs;
+	delete[] receiveIov;
+	delete[] receiveRing;
+}
+
+bool WusbDatagramChannel::open( const QHostAddress & destinationAddress, int destinationPort ) {
+	if ( socketFD >= 0 ) close();
+	// hubs are IPv4 devices (discovery is done by IPv4 broadcast)
+	if ( destinationAddress.protocol() != QAbstractSocket::IPv4Protocol ) {
+		lastError = QString("Not an IPv4 address: %1").arg( destinationAddress.toString() );
+		logger->error( lastError );
+		return false;
+	}
+
+	socketFD = ::socket( AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+	if ( socketFD < 0 ) {
+		setError("Cannot create socket");
+		return false;
+	}
+	// bind to any interface / random port
+	struct sockaddr_in localAddr;
+	::memset( &localAddr, 0, sizeof(localAddr) );
+	localAddr.sin_family = AF_INET;
+	localAddr.sin_addr.s_addr = htonl( INADDR_ANY );
+	localAddr.sin_port = 0;
+	if ( ::bind( socketFD, (struct sockaddr*) &localAddr, sizeof(localAddr) ) != 0 ) {
+		setError("Cannot bind to interface");
+		::close( socketFD );
+		socketFD = -1;
+		return false;
+	}
+
+	destSockAddr.sin_family = AF_INET;
+	destSockAddr.sin_port = htons( destinationPort );
+	destSockAddr.sin_addr.s_addr = htonl( destinationAddress.toIPv4Address() );
+
+	numQueued = 0;
+	numReceived = 0;
+	readNotifier = new QSocketNotifier( socketFD, QSocketNotifier::Read, this );
+	connect( readNotifier, SIGNAL(activated(int)), this, SIGNAL(readyRead()) );
+	return true;
+}
+
+void WusbDatagramChannel::close() {
+	if ( readNotifier ) {
+		readNotifier->setEnabled( false );
+		delete readNotifier;
+		readNotifier = NULL;
+	}
+	if ( socketFD >= 0 ) {
+		::close( socketFD );
+		socketFD = -1;
+	}
+	numQueued = 0;
+	numReceived = 0;
+}
+
+bool WusbDatagramChannel::isOpen() const {
+	return socketFD >= 0;
+}
+
+int WusbDatagramChannel::socketDescriptor() const {
+	return socketFD;
+}
+
+bool WusbDatagramChannel::setPathMTUDiscovery( bool enable ) {
+	if ( socketFD < 0 ) return false;
+	int value = enable? IP_PMTUDISC_DO : IP_PMTUDISC_WANT;
+	if ( ::setsockopt( socketFD, IPPROTO_IP, IP_MTU_DISCOVER, &value, sizeof(value) ) != 0 ) {
+		setError("Cannot set path MTU discovery");
+		logger->warn( lastError );
+		return false;
+	}
+	return true;
+}
+
+int WusbDatagramChannel::pathMTU() const {
+	if ( destSockAddr.sin_family != AF_INET ) return -1;
+	// IP_MTU is only available on a connected socket - our socket must not be connected
+	// (hub may answer from other port): ask with a temporary socket (nothing is sent)
+	int fd = ::socket( AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0 );
+	if ( fd < 0 ) return -1;
+	int mtu = -1;
+	socklen_t len = sizeof(mtu);
+	if ( ::connect( fd, (const struct sockaddr*) &destSockAddr, sizeof(destSockAddr) ) != 0 ||
+			::getsockopt( fd, IPPROTO_IP, IP_MTU, &mtu, &len ) != 0 )
+		mtu = -1;
+	::close( fd );
+	return mtu > WUSB_DATAGRAM_IP_UDP_HEADER_LEN? mtu - WUSB_DATAGRAM_IP_UDP_HEADER_LEN : -1;
+}
+
+bool WusbDatagramChannel::lastSendTooBig() const {
+	return sendTooBig;
+}
+
+bool WusbDatagramChannel::queueDatagram( const char * header, int headerLen, const char * payload, int payloadLen ) {
+	if ( socketFD < 0 ) return false;
+	bool res = true;
+	if ( numQueued >= WUSB_DATAGRAM_MAX_SEND_BATCH )
+		res = flush();
+
+	struct iovec * iov = &sendIov[ numQueued * 2 ];
+	iov[0].iov_base = (void*) header;
+	iov[0].iov_len  = headerLen;
+	iov[1].iov_base = (void*) payload;
+	iov[1].iov_len  = payloadLen;
+
+	struct msghdr & msg = sendMsgs[ numQueued ].msg_hdr;
+	::memset( &msg, 0, sizeof(msg) );
+	msg.msg_name    = &destSockAddr;
+	msg.msg_namelen = sizeof(destSockAddr);
+	msg.msg_iov     = iov;
+	msg.msg_iovlen  = ( payload && payloadLen > 0 )? 2 : 1;
+	numQueued++;
+	return res;
+}
+
+bool WusbDatagramChannel::flush() {
+	if ( numQueued == 0 ) return true;
+	if ( socketFD < 0 ) {
+		numQueued = 0;
+		return false;
+	}
+
+	sendTooBig = false;
+	int sent = 0;
+	while ( sent < numQueued ) {
+		int retVal = ::sendmmsg( socketFD, &sendMsgs[sent], numQueued - sent, 0 );
+		if ( retVal < 0 ) {
+			if ( errno == EINTR ) continue;
+			if ( ( errno == EAGAIN || errno == EWOULDBLOCK ) && waitForWritable() ) continue;
+			sendTooBig = ( errno == EMSGSIZE );
+			setError("Cannot write on network");
+			logger->warn( QString("%1 (%2 datagrams dropped)").arg(
+					lastError, QString::number( numQueued - sent ) ) );
+			numQueued = 0;
+			return false;
+		}
+		sent += retVal;
+	}
+	if ( logger->isTraceEnabled() )
+		logger->trace(QString("Wrote %1 datagrams on network").arg( QString::number( sent ) ) );
+	numQueued = 0;
+	return true;
+}
+
+int WusbDatagramChannel::queuedDatagrams() const {
+	return numQueued;
+}
+
+void WusbDatagramChannel::discardQueued() {
+	numQueued = 0;
+}
+
+int WusbDatagramChannel::receiveBatch() {
+	numReceived = 0;
+	if ( socketFD < 0 ) return 0;
+
+	int retVal;
+	do {
+		retVal = ::recvmmsg( socketFD, receiveMsgs, numReceiveSlots, MSG_DONTWAIT, NULL );
+	} while ( retVal < 0 && errno == EINTR );
+
+	if ( retVal < 0 ) {
+		if ( errno != EAGAIN && errno != EWOULDBLOCK ) {
+			setError("Cannot read from network");
+			logger->warn( lastError );
+		}
+		return 0;
+	}
+	for ( int i = 0; i < retVal; i++ ) {
+		if ( receiveMsgs[i].msg_hdr.msg_flags & MSG_TRUNC )
+			logger->warn(QString("Received datagram truncated to %1 bytes").arg( QString::number( receiveSlotSize ) ) );
+		// reset flags for next use of this slot
+		receiveMsgs[i].msg_hdr.msg_flags = 0;
+	}
+	numReceived = retVal;
+	return numReceived;
+}
+
+const char * WusbDatagramChannel::receivedData( int idx ) const {
+	if ( idx < 0 || idx >= numReceived ) return NULL;
+	return receiveRing + idx * receiveSlotSize;
+}
+
+int WusbDatagramChannel::receivedLength( int idx ) const {
+	if ( idx < 0 || idx >= numReceived ) return 0;
+	return receiveMsgs[idx].msg_len;
+}
+
+const QString & WusbDatagramChannel::errorString() const {
+	return lastError;
+}
+
+bool WusbDatagramChannel::waitForWritable() {
+	struct pollfd pfd;
+	pfd.fd = socketFD;
+	pfd.events = POLLOUT;
+	pfd.revents = 0;
+	return ::poll( &pfd, 1, WUSB_DATAGRAM_SEND_WAIT_TIMEOUT ) > 0;
+}
+
+void WusbDatagramChannel::setError( const QString & prefix ) {
+	lastError = QString("%1: %2").arg( prefix, QString::fromLocal8Bit( ::strerror( errno ) ) );
+}
@@ -0,0 +1,128 @@
+/*
+ * WusbDatagramChannel.h
+ * Linux native datagram (UDP) channel for WUSB data connection.
+ * Sends all queued datagrams with one <tt>sendmmsg()</tt> call and reads
+ * incoming datagrams with <tt>recvmmsg()</tt> into a preallocated ring of slots.
+ *
+ * @author:		Sebastian Kolbe-Nusser &lt;Sebastian DOT Kolbe AT gmail DOT com&gt;
+ * @version:	$Id$
+ * @created:	2011-04-12
+ */
+
+#ifndef WUSBDATAGRAMCHANNEL_H_
+#define WUSBDATAGRAMCHANNEL_H_
+
+#include <QObject>
+#include <QString>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+class QHostAddress;
+class QSocketNotifier;
+class Logger;
+
+/** Max. number of datagrams written with one system call */
+#define WUSB_DATAGRAM_MAX_SEND_BATCH			64
+/** Default number of receive slots (datagrams read with one system call) */
+#define WUSB_DATAGRAM_DEFAULT_RECEIVE_SLOTS		32
+/** Default size of one receive slot (hub may concatenate messages - so this is bigger than MTU) */
+#define WUSB_DATAGRAM_DEFAULT_SLOT_SIZE			16384
+/** Max. time (ms) to wait for a writable socket if socket send buffer is full */
+#define WUSB_DATAGRAM_SEND_WAIT_TIMEOUT			100
+/** Length of IPv4 and UDP header (difference between path MTU and max. datagram size) */
+#define WUSB_DATAGRAM_IP_UDP_HEADER_LEN			28
+
+class WusbDatagramChannel : public QObject {
+	Q_OBJECT
+public:
+	WusbDatagramChannel( Logger * parentLogger,
+			int numReceiveSlots = WUSB_DATAGRAM_DEFAULT_RECEIVE_SLOTS,
+			int receiveSlotSize = WUSB_DATAGRAM_DEFAULT_SLOT_SIZE,
+			QObject * parent = 0 );
+	virtual ~WusbDatagramChannel();
+
+	/**
+	 * Opens socket (bound to any interface and a random port) for sending to given destination.
+	 * @return	<code>true</code> if socket could be opened (<code>false</code> for a non IPv4 destination).
+	 */
+	bool open( const QHostAddress & destinationAddress, int destinationPort );
+	/** Closes socket. Datagrams not flushed are dropped. */
+	void close();
+	bool isOpen() const;
+	/** Native socket descriptor (or <tt>-1</tt> if not open) */
+	int socketDescriptor() const;
+	/**
+	 * Enables path MTU discovery: datagrams are sent with DF flag set and never fragmented
+	 * locally - a datagram bigger than known path MTU fails with <tt>EMSGSIZE</tt>.
+	 */
+	bool setPathMTUDiscovery( bool enable );
+	/**
+	 * Max. size of a datagram (UDP payload) to destination as currently known by kernel.
+	 * @return	datagram size or <tt>-1</tt> if not available
+	 */
+	int pathMTU() const;
+	/** Last <tt>flush()</tt> failed because a datagram was bigger than path MTU */
+	bool lastSendTooBig() const;
+
+	/**
+	 * Queues a datagram composed of <tt>header</tt> and <tt>payload</tt> (may be <tt>NULL</tt>).
+	 * Data is <em>not</em> copied - both buffers must stay valid until <tt>flush()</tt> is called.
+	 * If queue is full it is flushed implicitly.
+	 * @return	<code>false</code> if an implicit flush failed.
+	 */
+	bool queueDatagram( const char * header, int headerLen, const char * payload = 0, int payloadLen = 0 );
+	/**
+	 * Writes all queued datagrams to network.
+	 * @return	<code>true</code> if all datagrams were written.
+	 */
+	bool flush();
+	/** Number of datagrams queued but not written */
+	int queuedDatagrams() const;
+	/** Drops datagrams queued but not written (e.g. rest of an URB after an implicit flush failed) */
+	void discardQueued();
+
+	/**
+	 * Reads all (up to number of receive slots) pending datagrams from socket.
+	 * Received data is valid until next call of this method.
+	 * @return	number of datagrams read (<tt>0</tt> if there is no more data)
+	 */
+	int receiveBatch();
+	/** Data of datagram <tt>idx</tt> read by last <tt>receiveBatch()</tt> */
+	const char * receivedData( int idx ) const;
+	/** Length of datagram <tt>idx</tt> read by last <tt>receiveBatch()</tt> */
+	int receivedLength( int idx ) const;
+
+	/** Textual description of last error */
+	const QString & errorString() const;
+
+private:
+	Logger * logger;
+	int socketFD;
+	QSocketNotifier * readNotifier;
+	struct sockaddr_in destSockAddr;
+	QString lastError;
+	bool sendTooBig;
+
+	/* send queue */
+	struct mmsghdr sendMsgs[WUSB_DATAGRAM_MAX_SEND_BATCH];
+	struct iovec sendIov[WUSB_DATAGRAM_MAX_SEND_BATCH * 2];
+	int numQueued;
+
+	/* receive ring */
+	int numReceiveSlots;
+	int receiveSlotSize;
+	char * receiveRing;
+	struct mmsghdr * receiveMsgs;
+	struct iovec * receiveIov;
+	int numReceived;
+
+	bool waitForWritable();
+	void setError( const QString & prefix );
+
+signals:
+	/** Datagrams are available for reading */
+	void readyRead();
+};
+
+#endif /* WUSBDATAGRAMCHANNEL_H_ */
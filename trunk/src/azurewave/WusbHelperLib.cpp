@@ -62,6 +62,35 @@ void WusbHelperLib::appendPacketLength( QByteArray & buffer, unsigned int lenVal
 	buffer.append(  (lenValue & 0x000000ff) );
 }
 
+void WusbHelperLib::writeTransactionHeader( char * buffer, int sendTAN, int recTAN, int tanCount ) {
+	buffer[0] = (uint8_t) sendTAN;
+	buffer[1] = (uint8_t) recTAN;
+	buffer[2] = 0x10;
+	buffer[3] = (uint8_t) tanCount;
+}
+void WusbHelperLib::writeMarker55Header( char * buffer, uint8_t param1, uint8_t intervalVal ) {
+	buffer[0] = 0x55;
+	buffer[1] = 0x55;
+	buffer[2] = param1;
+	buffer[3] = intervalVal;
+}
+unsigned int WusbHelperLib::writePacketIDHeader( char * buffer ) {
+	// LSB first (see appendPacketIDHeader)
+	unsigned int counter = getIncrementedPacketCounter();
+	buffer[0] =  (counter & 0x000000ff);
+	buffer[1] = ((counter & 0x0000ff00) >> 8 );
+	buffer[2] = ((counter & 0x00ff0000) >> 16 );
+	buffer[3] = ((counter & 0xff000000) >> 24 );
+	return counter;
+}
+void WusbHelperLib::writePacketLength( char * buffer, unsigned int lenValue ) {
+	// MSB first (see appendPacketLength)
+	buffer[0] = '\0';
+	buffer[1] = ((lenValue & 0x00ff0000) >> 16 );
+	buffer[2] = ((lenValue & 0x0000ff00) >> 8 );
+	buffer[3] =  (lenValue & 0x000000ff);
+}
+
 QString WusbHelperLib::messageToString( const QByteArray & bytes, int lengthToPrint ) {
 	if ( bytes.isNull() || bytes.isEmpty() ) return QString::null;
 	if ( lengthToPrint <= 0 ) lengthToPrint = bytes.length();
@@ -27,6 +27,13 @@ public:
 	static unsigned int appendPacketIDHeader( QByteArray & buffer );
 	static void appendPacketLength( QByteArray & buffer, unsigned int lenValue );
 
+	/* The following methods write the same header parts into a preallocated buffer
+	 * (at least 4 bytes each) instead of appending to a byte array */
+	static void writeTransactionHeader( char * buffer, int sendTAN, int recTAN, int tanCount );
+	static void writeMarker55Header( char * buffer, uint8_t param1 = 0, uint8_t intervalVal = 0 );
+	static unsigned int writePacketIDHeader( char * buffer );
+	static void writePacketLength( char * buffer, unsigned int lenValue );
+
 
 	/** Debug function: Print at most <em>length</em> bytes in hex notation into result string. */
 	static QString messageToString( const QByteArray & bytes, int lengthToPrint = 4 );
@@ -10,6 +10,8 @@
 #include "WusbStack.h"
 #include "../utils/Logger.h"
 #include "WusbHelperLib.h"
+#include "../BasicUtils.h"
+#include "../ConfigManager.h"
 #include <QByteArray>
 #include <QMetaType>
 #include <string.h>
@@ -22,12 +24,18 @@ WusbMessageBuffer::WusbMessageBuffer( WusbStack * owner, int mtuSize )
 	parentRef = owner;
 	logger = owner->getLogger();
 	if ( mtuSize < 1500 ) mtuSize = 1500;
-	lastReceivedPacket = new QByteArray();
-	lastReceivedPacket->reserve( mtuSize );
+	receiveWindowSynced = false;
+	expectedSenderTAN = 0;
+	receiveWindowMask = 0;
+	gapOpenedMillis = 0L;
+	gapTimeoutMillis = ConfigManager::getInstance().getIntValue( "azurewave.wusb.receiveGapTimeout", WUSB_MESSAGE_DEFAULT_GAP_TIMEOUT );
+	if ( gapTimeoutMillis < WUSB_AZUREWAVE_TIMER_INTERVAL )
+		gapTimeoutMillis = WUSB_AZUREWAVE_TIMER_INTERVAL;
 
 	haveIncompleMessages = false;
 	incompleteMessages = new struct WusbMessageBuffer::sAnswerMessageParts[256];
-	::memset( incompleteMessages, 0, 255 * sizeof(struct WusbMessageBuffer::sAnswerMessageParts) );
+	for ( int i = 0; i < 256; i++ )
+		incompleteMessages[i].slotInUse = false;
 
 	// for usage in event queueing we have to register TypeOfMessage in QT-Metatype system
 	// XXX this is not threadsafe...
@@ -35,21 +43,88 @@ WusbMessageBuffer::WusbMessageBuffer( WusbStack * owner, int mtuSize )
 		qRegisterMetaType<WusbMessageBuffer::eTypeOfMessage>("WusbMessageBuffer::eTypeOfMessage");
 		WusbMessageBuffer::isFirstInstance = false;
 	}
-
-	start();	// start thread process
 }
 
 WusbMessageBuffer::~WusbMessageBuffer() {
+	// buffers of incomplete messages go back to pool
+	for ( int i = 0; i < 256; i++ )
+		if ( incompleteMessages[i].slotInUse )
+			incompleteMessages[i].contentURB.release();
+	delete[] incompleteMessages;
+	clearReceiveWindow();
+}
+
+void WusbMessageBuffer::reset() {
+	clearReceiveWindow();
+	receiveWindowSynced = false;
+	for ( int i = 0; i < 256; i++ ) {
+		if ( incompleteMessages[i].slotInUse )
+			incompleteMessages[i].contentURB.release();
+		incompleteMessages[i].slotInUse = false;
+	}
+	haveIncompleMessages = false;
+}
+
+void WusbMessageBuffer::detachAnswerBuffers( unsigned int packetID ) {
+	if ( !haveIncompleMessages ) return;
+	for ( int i = 0; i < 256; i++ ) {
+		struct WusbMessageBuffer::sAnswerMessageParts & message = incompleteMessages[i];
+		if ( !message.slotInUse || !message.contentURB.borrowed ) continue;
+		if ( packetID && message.packetNum != packetID ) continue;
+		// data received so far is useless (URB has no receiver) - only the buffer is replaced
+		message.contentURB = parentRef->allocateURBBuffer( qMax( message.contentLength, message.receivedLength ) );
+	}
+}
+
+void WusbMessageBuffer::clearReceiveWindow() {
+	for ( int i = 0; i < WUSB_MESSAGE_RECEIVE_WINDOW; i++ )
+		heldPackets[i].release();
+	receiveWindowMask = 0;
+	gapOpenedMillis = 0L;
+}
+
+void WusbMessageBuffer::advanceReceiveWindow() {
+	while ( true ) {
+		expectedSenderTAN++;
+		receiveWindowMask >>= 1;
+		if ( ( receiveWindowMask & 1 ) == 0 ) break;
+		// next packet was received before: process it now
+		receiveWindowMask &= ~1u;
+		PooledBuffer & held = heldPackets[ expectedSenderTAN % WUSB_MESSAGE_RECEIVE_WINDOW ];
+		PooledBuffer packet = held;
+		held = PooledBuffer();
+		processMessage( packet.data, packet.length );
+		packet.release();
+	}
+	// packets still held back: a new gap is waited for from now on
+	gapOpenedMillis = receiveWindowMask? currentTimeMillis() : 0L;
+}
+
+void WusbMessageBuffer::checkReceiveWindowTimeout( long long now ) {
+	if ( receiveWindowMask == 0 ) return;
+	// (and workaround for clock warping...)
+	if ( gapOpenedMillis <= now && now - gapOpenedMillis < gapTimeoutMillis ) return;
+
+	// skip missing packets up to first packet held back
+	int skip = 1;
+	while ( ( receiveWindowMask & ( 1u << skip ) ) == 0 ) skip++;
+	logger->warn(QString("Packet(s) missing in receive window (TAN=%1, %2 packets) - skipped").arg(
+			QString::number( expectedSenderTAN, 16 ), QString::number( skip ) ) );
+	expectedSenderTAN += skip - 1;
+	receiveWindowMask >>= skip - 1;
+	advanceReceiveWindow();
 }
 
-void WusbMessageBuffer::receive( const QByteArray & bytes ) {
+void WusbMessageBuffer::receive( const char * bytes, int length ) {
 	// Sanity check
-	if ( bytes.isNull() || bytes.isEmpty() ) return;
+	if ( !bytes || length <= 0 ) return;
 	// smaller packets are impossible in current WUSB/AzureWave protocol (minimal header takes 4 bytes)
-	if ( bytes.length() < 4 ) return;
+	if ( length < 4 ) return;
 
 	// Status message
-	if ( bytes.length() == 4 ) {
+	// These are not part of the receive window: they do not carry a sender TAN of the data stream
+	// and must not sync or advance the window (a missing status message must not open a gap, too).
+	if ( length == 4 ) {
 		// Device status message (open/close/etc.)
 		if ( bytes[0] == 0x0 && bytes[1] == 0x0 && bytes[3] == 0x0 ) {
 			// special treatment for case: 00 00 10 00
@@ -75,7 +150,8 @@ void WusbMessageBuffer::receive( const QByteArray & bytes ) {
 			default:
 				// ??? strange things are going on (error message from hub?)
 				if ( logger->isWarnEnabled() )
-					logger->warn(QString( "Received unknown message from hub: %1").arg( WusbHelperLib::messageToString( bytes ) ) );
+					logger->warn(QString( "Received unknown message from hub: %1").arg(
+							WusbHelperLib::messageToString( (const uint8_t*) bytes, length ) ) );
 				return;
 				break;
 			}
@@ -87,18 +163,66 @@ void WusbMessageBuffer::receive( const QByteArray & bytes ) {
 		return;
 	} // 4 bytes messages
 
-	if ( bytes == (*lastReceivedPacket) ) {
-		// Duplicate packet received!
+	// Receive window: every data packet carries sender TAN of hub (incremented per packet).
+	// Packets are processed strictly in order of sender TAN - duplicates (retransmits) are
+	// detected by TAN only, packets ahead of a gap are held back until gap is closed.
+	uint8_t senderTAN = bytes[0];
+	if ( !receiveWindowSynced ) {
+		expectedSenderTAN = senderTAN;
+		receiveWindowMask = 0;
+		receiveWindowSynced = true;
+	}
+	uint8_t distance = senderTAN - expectedSenderTAN;	// modulo 256
+
+	if ( distance == 0 ) {
+		processMessage( bytes, length );
+		advanceReceiveWindow();
+	} else if ( distance < WUSB_MESSAGE_RECEIVE_WINDOW ) {
+		if ( receiveWindowMask & ( 1u << distance ) ) {
+			// Duplicate of a held packet
+			if ( logger->isDebugEnabled() )
+				logger->debug(QString("Duplicate packet received (TAN=%1, held)").arg( QString::number( senderTAN, 16 ) ) );
+			emit statusMessage( DEVICE_RECEIVED_DUP, bytes[0], bytes[1], bytes[3] );
+			return;
+		}
+		// out of order: keep a copy until gap is closed
+		if ( logger->isDebugEnabled() )
+			logger->debug(QString("Packet out of order (TAN=%1, expected=%2) - held back").arg(
+					QString::number( senderTAN, 16 ), QString::number( expectedSenderTAN, 16 ) ) );
+		PooledBuffer packet = parentRef->allocateURBBuffer( length );
+		::memcpy( packet.data, bytes, length );
+		heldPackets[ senderTAN % WUSB_MESSAGE_RECEIVE_WINDOW ] = packet;
+		if ( receiveWindowMask == 0 )
+			gapOpenedMillis = currentTimeMillis();
+		receiveWindowMask |= ( 1u << distance );
+	} else if ( distance >= 256 - WUSB_MESSAGE_RECEIVE_WINDOW ) {
+		// Duplicate packet received (already processed)!
 		if ( logger->isDebugEnabled() )
-			logger->debug(QString("Duplicate packet received with length %1").arg( QString::number(bytes.length() ) ) );
+			logger->debug(QString("Duplicate packet received (TAN=%1) with length %2").arg(
+					QString::number( senderTAN, 16 ), QString::number( length ) ) );
 		emit statusMessage( DEVICE_RECEIVED_DUP, bytes[0], bytes[1], bytes[3] );
-		return;
+	} else {
+		// far outside of window: gap will never be closed -> process held packets and restart window
+		logger->warn(QString("Lost sync of receive window (TAN=%1, expected=%2)").arg(
+				QString::number( senderTAN, 16 ), QString::number( expectedSenderTAN, 16 ) ) );
+		for ( int i = 1; i < WUSB_MESSAGE_RECEIVE_WINDOW; i++ ) {
+			if ( ( receiveWindowMask & ( 1u << i ) ) == 0 ) continue;
+			PooledBuffer & held = heldPackets[ (uint8_t) ( expectedSenderTAN + i ) % WUSB_MESSAGE_RECEIVE_WINDOW ];
+			processMessage( held.data, held.length );
+			held.release();
+		}
+		receiveWindowMask = 0;
+		gapOpenedMillis = 0L;
+		expectedSenderTAN = senderTAN;
+		processMessage( bytes, length );
+		advanceReceiveWindow();
 	}
-	lastReceivedPacket->clear();
-	lastReceivedPacket->append( bytes );
+}
 
+void WusbMessageBuffer::processMessage( const char * bytes, int length ) {
 	if ( logger->isDebugEnabled() )
-		logger->debug(QString("Received message from hub: %1").arg(WusbHelperLib::messageToString(bytes,0)) );
+		logger->debug(QString("Received message from hub: %1").arg(
+				WusbHelperLib::messageToString( (const uint8_t*) bytes, qMin( length, WUSB_AZUREWAVE_RECEIVE_HEADER_LEN ) ) ) );
 
 /*	printf("Last message incomplete = %s, haveContentURB = %s contentLenght=%i\n",
 			(lastMessageWasIncomplete?"true":"false"),
@@ -115,7 +239,7 @@ void WusbMessageBuffer::receive( const QByteArray & bytes ) {
 
 	if ( !incompleteMessages[tanMsg].slotInUse ) {
 		// Extract essential message details
-		struct WusbMessageBuffer::sAnswerMessageParts message = splitMessage( bytes );
+		struct WusbMessageBuffer::sAnswerMessageParts message = splitMessage( bytes, length );
 
 		if ( message.isCorrect && message.isComplete ) {
 // 			lastMessageWasIncomplete = false;
@@ -137,35 +261,15 @@ void WusbMessageBuffer::receive( const QByteArray & bytes ) {
 		}
 	} else {
 		// ELSE case: we need to continue a previous message
-		struct WusbMessageBuffer::sAnswerMessageParts contMsg = splitContinuedMessage( bytes, incompleteMessages[tanMsg] );
+		struct WusbMessageBuffer::sAnswerMessageParts contMsg = splitContinuedMessage( bytes, length, incompleteMessages[tanMsg] );
 		if ( contMsg.isCorrect ) {
 			emit informPacketMeta( contMsg.receiverTAN, contMsg.TAN, contMsg.packetNum );
-			printf("Appending bytes to buffer of incomplete message (append=%i, current=%i, all=%i)\n",
-					bytes.mid( 4 ).size(),
-					incompleteMessages[tanMsg].contentURB->size(),
-					incompleteMessages[tanMsg].contentLength );
-
-			incompleteMessages[tanMsg].contentURB->append( bytes.mid( 4 ) );	// append all URB data to buffer
 			incompleteMessages[tanMsg].receiverTAN = contMsg.receiverTAN;		// copy receive TAN
-
-			if ( incompleteMessages[tanMsg].contentLength == incompleteMessages[tanMsg].contentURB->size() ) {
-				// message completed - emit all data and continue normal
-				logger->debug("message is completed! Size=%1 ID=0x%2\n",
-						QString::number(incompleteMessages[tanMsg].contentLength),
-						QString::number(incompleteMessages[tanMsg].packetNum,16) );
-				emit urbMessage( incompleteMessages[tanMsg].packetNum, incompleteMessages[tanMsg].contentURB );
-				incompleteMessages[tanMsg].slotInUse = false;
-
-			} else if ( incompleteMessages[tanMsg].contentLength < incompleteMessages[tanMsg].contentURB->size() ) {
-				// Houston we have a problem...
-				logger->warn(QString("Received more data than expected! (%1 > %2)").arg(
-						QString::number( incompleteMessages[tanMsg].contentURB->size() ),
-						QString::number( incompleteMessages[tanMsg].contentLength ) ) );
-			}
+			appendContinuedMessage( tanMsg, bytes + 4, length - 4 );
 		} else {
 			// if message is not correct, we cannot do anything ?
 			logger->warn(QString("Received corrupt message with len = %1").arg(
-					QString::number( bytes.size() ) ) );
+					QString::number( length ) ) );
 		}
 	}
 
@@ -202,10 +306,43 @@ void WusbMessageBuffer::receive( const QByteArray & bytes ) {
 }
 
 
-struct WusbMessageBuffer::sAnswerMessageParts WusbMessageBuffer::splitMessage( const QByteArray & bytes ) {
+void WusbMessageBuffer::appendContinuedMessage( uint8_t tanMsg, const char * bytes, int length ) {
+	struct WusbMessageBuffer::sAnswerMessageParts & message = incompleteMessages[tanMsg];
+	if ( logger->isDebugEnabled() )
+		logger->debug(QString("Appending bytes to buffer of incomplete message (append=%1, current=%2, all=%3)").arg(
+				QString::number( length ), QString::number( message.receivedLength ),
+				QString::number( message.contentLength ) ) );
+
+	// payload is written directly at its final position in URB buffer
+	int bytesToCopy = qMin( length, message.contentLength - message.receivedLength );
+	if ( bytesToCopy > 0 ) {
+		::memcpy( message.contentURB.data + message.receivedLength, bytes, bytesToCopy );
+		message.receivedLength += bytesToCopy;
+	}
+	if ( bytesToCopy < length ) {
+		// Houston we have a problem...
+		logger->warn(QString("Received more data than expected! (%1 > %2)").arg(
+				QString::number( message.receivedLength + length - bytesToCopy ),
+				QString::number( message.contentLength ) ) );
+	}
+
+	if ( message.receivedLength == message.contentLength ) {
+		// message completed - emit all data and continue normal
+		if ( logger->isDebugEnabled() )
+			logger->debug(QString("message is completed! Size=%1 ID=0x%2").arg(
+					QString::number( message.contentLength ),
+					QString::number( message.packetNum, 16 ) ) );
+		message.slotInUse = false;
+		emit urbMessage( message.packetNum, message.contentURB );
+		message.contentURB = PooledBuffer();
+	}
+}
+
+struct WusbMessageBuffer::sAnswerMessageParts WusbMessageBuffer::splitMessage( const char * bytes, int length ) {
 	struct WusbMessageBuffer::sAnswerMessageParts retValue;
 	retValue.isCorrect = false;
-	if ( bytes.length() < WUSB_AZUREWAVE_RECEIVE_HEADER_LEN ) return retValue;
+	retValue.slotInUse = false;
+	if ( length < WUSB_AZUREWAVE_RECEIVE_HEADER_LEN ) return retValue;
 	if ( bytes[2] != 0x10 ) return retValue;
 
 	retValue.senderTAN   = bytes[0];
@@ -227,7 +364,16 @@ struct WusbMessageBuffer::sAnswerMessageParts WusbMessageBuffer::splitMessage( c
 	contentLength |= ((bytes[21] & 0x00ff) << 16);
 	retValue.contentLength = contentLength;
 
-	if ( bytes.length() - WUSB_AZUREWAVE_RECEIVE_HEADER_LEN < contentLength )
+	// length is taken from network: a corrupt header must not make us allocate a huge buffer
+	if ( contentLength > parentRef->maxAnswerLength( packetNum ) ) {
+		logger->warn(QString("Answer too long (ID = 0x%1, length = %2, max. %3) - dropped").arg(
+				QString::number( packetNum, 16 ), QString::number( contentLength ),
+				QString::number( parentRef->maxAnswerLength( packetNum ) ) ) );
+		return retValue;
+	}
+
+	int payloadLength = length - WUSB_AZUREWAVE_RECEIVE_HEADER_LEN;
+	if ( payloadLength < contentLength )
 		retValue.isComplete = false;	// USB URB is not entire contained in network packet!
 	else
 		retValue.isComplete = true;
@@ -237,10 +383,14 @@ struct WusbMessageBuffer::sAnswerMessageParts WusbMessageBuffer::splitMessage( c
 				QString::number(retValue.senderTAN & 0xff,16), QString::number(retValue.receiverTAN & 0xff,16),QString::number(retValue.TAN & 0xff,16),
 				QString::number(retValue.packetNum&0xffffffff,16),  QString::number( contentLength ) ) );
 
-	QByteArray *content = new QByteArray();
-	content->reserve( contentLength );
-	content->append( bytes.right( bytes.length() - WUSB_AZUREWAVE_RECEIVE_HEADER_LEN ) );
-	retValue.contentURB = content;
+	// buffer for complete URB (from host URB or pool): continued packets are written in place
+	retValue.contentURB = parentRef->allocateAnswerBuffer( qMax( contentLength, payloadLength ), packetNum );
+	::memcpy( retValue.contentURB.data, bytes + WUSB_AZUREWAVE_RECEIVE_HEADER_LEN, payloadLength );
+	retValue.receivedLength = payloadLength;
+	if ( retValue.isComplete )
+		retValue.contentURB.length = payloadLength;
+	else
+		retValue.contentURB.length = contentLength;
 
 	retValue.isCorrect = true;
 	return retValue;
@@ -248,16 +398,17 @@ struct WusbMessageBuffer::sAnswerMessageParts WusbMessageBuffer::splitMessage( c
 
 
 struct WusbMessageBuffer::sAnswerMessageParts WusbMessageBuffer::splitContinuedMessage(
-		const QByteArray & bytes,
+		const char * bytes, int length,
 		const WusbMessageBuffer::sAnswerMessageParts & prevMessageDesc ) {
 	struct WusbMessageBuffer::sAnswerMessageParts retValue;
 	retValue.isCorrect = false;
-	if ( bytes.length() < 4 ) return retValue;
+	if ( length < 4 ) return retValue;
 	if ( bytes[2] != 0x10 ) return retValue;
 
 	retValue.senderTAN   = bytes[0];
 	retValue.receiverTAN = bytes[1];
 	retValue.TAN = bytes[3];
+	retValue.packetNum = prevMessageDesc.packetNum;
 	uint8_t expectedRectan = prevMessageDesc.receiverTAN;
 	if ( expectedRectan == 255 ) expectedRectan = 0;
 	else expectedRectan++;
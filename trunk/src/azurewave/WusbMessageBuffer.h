@@ -12,11 +12,18 @@
 #include <QThread>
 #include <QString>
 #include <QByteArray>
+#include "../utils/BufferPool.h"
 #include <stdint.h>
 
 class WusbStack;
 class Logger;
 
+/** Size of receive window: packets ahead of expected sender TAN which are held back
+ * (and packets behind which are taken as duplicates). Max. 32 (one bit per packet). */
+#define WUSB_MESSAGE_RECEIVE_WINDOW		32
+/** Default time (ms) a gap in receive window is waited for to be closed (by a retransmit of hub) */
+#define WUSB_MESSAGE_DEFAULT_GAP_TIMEOUT	1000
+
 class WusbMessageBuffer : public QThread {
 	Q_OBJECT
 public:
@@ -51,15 +58,26 @@ private:
     	uint8_t TAN;
     	unsigned int packetNum;		// packet counter
     	int contentLength;	// length of contentURB
+    	int receivedLength;	// bytes of URB received until now
     	bool isComplete;
     	bool transactionCompleted;
-    	QByteArray * contentURB;
+    	PooledBuffer contentURB;	// URB data is reassembled in place
     };
 
 	WusbStack * parentRef;
 	Logger * logger;
-	QByteArray * internalBuffer;
-	QByteArray * lastReceivedPacket;
+	/** Receive window is initialized by first packet received */
+	bool receiveWindowSynced;
+	/** Sender TAN of next packet to process */
+	uint8_t expectedSenderTAN;
+	/** Bit <tt>i</tt> set: packet with sender TAN <tt>expectedSenderTAN + i</tt> is held back */
+	uint32_t receiveWindowMask;
+	/** Packets received out of order (index: sender TAN modulo window size) */
+	PooledBuffer heldPackets[WUSB_MESSAGE_RECEIVE_WINDOW];
+	/** Time the current gap in receive window was opened (<tt>0</tt>: no packet held back) */
+	long long gapOpenedMillis;
+	/** Max. time to wait for a missing packet until it is skipped */
+	int gapTimeoutMillis;
 	int bytesLeftInCurrentTask;
 //	struct WusbMessageBuffer::sAnswerMessageParts incompleteMessage;
 //	bool lastMessageWasIncomplete;
@@ -67,19 +85,41 @@ private:
 	struct WusbMessageBuffer::sAnswerMessageParts * incompleteMessages;
 
 
-	struct WusbMessageBuffer::sAnswerMessageParts splitMessage( const QByteArray & bytes );
+	struct WusbMessageBuffer::sAnswerMessageParts splitMessage( const char * bytes, int length );
 	struct WusbMessageBuffer::sAnswerMessageParts splitContinuedMessage(
-			const QByteArray & bytes, const WusbMessageBuffer::sAnswerMessageParts & prevMessageDesc );
-public slots:
+			const char * bytes, int length, const WusbMessageBuffer::sAnswerMessageParts & prevMessageDesc );
+	/** Process a packet in order of sender TAN */
+	void processMessage( const char * bytes, int length );
+	/** Next packet processed: process all held packets which are in order now */
+	void advanceReceiveWindow();
+	/** Drop all held packets */
+	void clearReceiveWindow();
+	/** Copy payload of a continued packet to its final position in URB buffer */
+	void appendContinuedMessage( uint8_t tanMsg, const char * bytes, int length );
+public:
 	/**
 	 * Receive bytes read from network and add message to internal buffering/processing.
+	 * Data is not referenced after return.
+	 */
+	void receive( const char * bytes, int length );
+	/** Reset receive state (new connection to device) */
+	void reset();
+	/**
+	 * Answers in reassembly which are written to buffer of host URB are moved to pooled buffers
+	 * (URB is given back without answer and its buffer must not be used anymore).
+	 * @param	packetID	answers of this URB only - all answers if <tt>0</tt>
+	 */
+	void detachAnswerBuffers( unsigned int packetID = 0 );
+	/**
+	 * Called periodically: a gap in receive window which is not closed in time is skipped
+	 * (missing packets are taken as lost) and the packets held back are processed.
 	 */
-	void receive( const QByteArray & bytes );
+	void checkReceiveWindowTimeout( long long now );
 signals:
 	/** Status changed (or an event occured) on/in connection */
 	void statusMessage( WusbMessageBuffer::eTypeOfMessage, uint8_t, uint8_t, uint8_t );
-	/** An URB was completely received and can be processed */
-	void urbMessage( unsigned int packetID, QByteArray * urbData );
+	/** An URB was completely received and can be processed (receiver has to release buffer) */
+	void urbMessage( unsigned int packetID, const PooledBuffer & urbData );
 	void informPacketMeta( int newReceiverTAN, int lastSessionTAN, unsigned int packetCounter );
 };
 
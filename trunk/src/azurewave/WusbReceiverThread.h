@@ -1,5 +1,7 @@
 /*
  * WusbReceiverThread.h
+ * I/O thread of a WUSB stack: runs the event loop for socket, timers and
+ * receive processing of exactly one stack (connection to one device).
  *
  * @author:		Sebastian Kolbe-Nusser &lt;Sebastian DOT Kolbe AT gmail DOT com&gt;
  * @version:	$Id$
@@ -11,15 +11,20 @@
 #include "WusbStack.h"
 #include "WusbReceiverThread.h"
 #include "WusbHelperLib.h"
+#include "WusbDatagramChannel.h"
+#include "../vhci/URBChannel.h"
 #include "../BasicUtils.h"
 #include "../USBconnectionWorker.h"
 #include "../utils/Logger.h"
 #include "../TI_USB_VHCI.h"
+#include "../ConfigManager.h"
 #include <QCoreApplication>
+#include <QThread>
 #include <QHostAddress>
-#include <QUdpSocket>
 #include <QTimer>
-#include <QLinkedList>
+#include <QSocketNotifier>
+#include <QMutexLocker>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
 
@@ -40,8 +45,9 @@ WusbStack::WusbStack( Logger *parentLogger, const QHostAddress & destinationAddr
 	destAddress = QHostAddress( destinationAddress );
 	destPort = destinationPort;
 	haveAnswer = false;
-	udpSocket = NULL;
-	maxMTU = WUSB_AZUREWAVE_NETWORK_DEFAULT_MTU;	// TODO make this configurable or auto detect
+	dataChannel = NULL;
+	closeRequestSent = false;
+	maxMTU = WUSB_AZUREWAVE_NETWORK_DEFAULT_MTU;
 	currentSendTransactionNum = -1;
 	currentReceiveTransactionNum = 0;
 	currentTransactionNum = 0xff;
@@ -50,23 +56,86 @@ WusbStack::WusbStack( Logger *parentLogger, const QHostAddress & destinationAddr
 	lastPacketReceiveTimeMillis = 0L;
 	lastSendAlivePacket = 0L;
 	connectionKeeperTimer = NULL;
+	ackTimer = NULL;
+	ackPending = false;
+	retransmitTimer = NULL;
+	srttMillis = 0;
+	rttVarMillis = 0;
+	haveRTTsample = false;
 	urbReceiver = NULL;
-	packetRefData = NULL;
+	urbChannel = NULL;
+	urbChannelToAttach = NULL;
+	urbChannelNotifier = NULL;
 	packetRefDataByPacketID.clear();
+	answerLengthByPacketID.clear();
+	urbsInFlight.clear();
+	urbsAwaitingAnswer.clear();
+	urbsUnacknowledged = 0;
+	isoURBsInFlight.clear();
+	isoURBsDropped = 0;
+	isoPacketTable = ConfigManager::getInstance().getBoolValue( WUSB_ISO_PACKET_TABLE_CONFIG_KEY, false );
+	flushSendQueuePosted = false;
+	takingURBrequests = false;
+	coalesceBatchLen = 0;
+
+	// size of send window: number of URBs sent to hub without waiting for an answer
+	sendWindowSize = ConfigManager::getInstance().getIntValue( "azurewave.wusb.sendWindow", WUSB_AZUREWAVE_DEFAULT_SEND_WINDOW );
+	if ( sendWindowSize < 1 ) sendWindowSize = 1;
+	if ( sendWindowSize > WUSB_AZUREWAVE_MAX_SEND_WINDOW ) sendWindowSize = WUSB_AZUREWAVE_MAX_SEND_WINDOW;
+
+	// send queue: control and interrupt URBs are sent before bulk URBs - bulk bytes are limited per round
+	int bulkBudget = ConfigManager::getInstance().getIntValue( "azurewave.wusb.bulkBudget", WUSB_AZUREWAVE_DEFAULT_BULK_BUDGET );
+	urbScheduler = new WusbURBScheduler( bulkBudget );
+	// packing of small URBs into one datagram (saves packets for chatty interrupt/bulk endpoints)
+	coalesceSmallURBs = ConfigManager::getInstance().getBoolValue( "azurewave.wusb.coalesceSmallURBs", false );
+
+	// delay of acknowledge messages: every packet received within this time is acknowledged by one message
+	ackDelayMillis = ConfigManager::getInstance().getIntValue( "azurewave.wusb.ackDelay", WUSB_AZUREWAVE_DEFAULT_ACK_DELAY );
+	if ( ackDelayMillis < 0 ) ackDelayMillis = 0;
+	if ( ackDelayMillis > WUSB_AZUREWAVE_MAX_ACK_DELAY ) ackDelayMillis = WUSB_AZUREWAVE_MAX_ACK_DELAY;
+
+	// limits of retransmit timeout: timeout itself adapts to measured round trip time
+	minRTOMillis = ConfigManager::getInstance().getIntValue( "azurewave.wusb.minRTO", WUSB_AZUREWAVE_DEFAULT_MIN_RTO );
+	maxRTOMillis = ConfigManager::getInstance().getIntValue( "azurewave.wusb.maxRTO", WUSB_AZUREWAVE_DEFAULT_MAX_RTO );
+	if ( minRTOMillis < 1 ) minRTOMillis = 1;
+	if ( maxRTOMillis < minRTOMillis ) maxRTOMillis = minRTOMillis;
+	rtoMillis = qBound( minRTOMillis, WUSB_AZUREWAVE_INITIAL_RTO, maxRTOMillis );
+	// XXX acknowledge of hub (next TAN expected) is inferred - a wrong guess would free slots of
+	// send window too early and give the hub duplicate transactions
+	retransmitEnabled = ConfigManager::getInstance().getBoolValue( "azurewave.wusb.retransmit", false );
+
+	// size of packets sent to hub: fixed size or discovered for every hub (network path and device)
+	configuredMTU = ConfigManager::getInstance().getIntValue( "azurewave.wusb.mtu", WUSB_AZUREWAVE_NETWORK_DEFAULT_MTU );
+	configuredMTU = qBound( WUSB_AZUREWAVE_NETWORK_MIN_MTU, configuredMTU, WUSB_AZUREWAVE_NETWORK_MAX_MTU );
+	mtuDiscovery = ConfigManager::getInstance().getBoolValue( "azurewave.wusb.mtuDiscovery", false );
+	hubMTUkey = QString("azurewave.hub.%1.mtu").arg( destAddress.toString() );
+	hubMTU = ConfigManager::getInstance().getIntValue( hubMTUkey, 0 );
+	if ( hubMTU != 0 )
+		hubMTU = qBound( WUSB_AZUREWAVE_NETWORK_MIN_MTU, hubMTU, WUSB_AZUREWAVE_NETWORK_MAX_MTU );
+	hubMTUchanged = false;
+	sendMTU = configuredMTU;
+	sendMTUconfirmed = true;
+
+	// pools of receive buffers: small URBs (up to MTU) and big URBs (reassembled from many packets)
+	smallURBpool = new BufferPool( maxMTU, WUSB_AZUREWAVE_SMALL_URB_POOL_SIZE );
+	largeURBpool = new BufferPool( WUSB_AZUREWAVE_LARGE_URB_BLOCK_SIZE, WUSB_AZUREWAVE_LARGE_URB_POOL_SIZE );
 
 	// init receive message buffer
 	messageBuffer = new WusbMessageBuffer( this, maxMTU );
 
+	// message buffer runs in I/O thread of stack: all messages are processed directly
 	connect( messageBuffer, SIGNAL(statusMessage(WusbMessageBuffer::eTypeOfMessage,uint8_t,uint8_t,uint8_t )),
 			this, SLOT(processStatusMessage(WusbMessageBuffer::eTypeOfMessage,uint8_t,uint8_t,uint8_t)),
-			Qt::QueuedConnection );
-	connect( messageBuffer, SIGNAL(urbMessage( unsigned int, QByteArray* )),
-			this, SLOT(processURBmessage( unsigned int, QByteArray* )), Qt::QueuedConnection );
+			Qt::DirectConnection );
+	connect( messageBuffer, SIGNAL(urbMessage( unsigned int, const PooledBuffer & )),
+			this, SLOT(processURBmessage( unsigned int, const PooledBuffer & )), Qt::DirectConnection );
 	connect( messageBuffer, SIGNAL(informPacketMeta( int, int, unsigned int )),
-			this, SLOT(informReceivedPacket( int, int, unsigned int )), Qt::QueuedConnection );
+			this, SLOT(informReceivedPacket( int, int, unsigned int )), Qt::DirectConnection );
 
-	connect( this, SIGNAL(receivedUDPdata(const QByteArray &)),
-			messageBuffer, SLOT(receive(const QByteArray &)), Qt::QueuedConnection);
+	// every stack has its own I/O thread: socket, timers, receive processing and
+	// hand-off of answers to URB receiver never touch the thread of creator (GUI)
+	receiverThread = new WusbReceiverThread( NULL );
+	moveToThread( receiverThread );
 
 	if ( logger->isInfoEnabled() )
 		logger->info(QString("WusbStack init completed for destination: %1:%2").
@@ -74,52 +143,153 @@ WusbStack::WusbStack( Logger *parentLogger, const QHostAddress & destinationAddr
 }
 
 WusbStack::~WusbStack() {
+	attachURBChannel( NULL );
 	closeConnection();
+	// URBs never sent or never answered are given back as failed (also if connection was not open)
+	if ( QThread::currentThread() == receiverThread || !receiverThread->isRunning() )
+		discardPendingURBs();
+	else
+		QMetaObject::invokeMethod( this, "discardPendingURBs", Qt::BlockingQueuedConnection );
+	// stop I/O thread - there is no more network traffic for this stack
+	receiverThread->quit();
+	if ( QThread::currentThread() != receiverThread )
+		receiverThread->wait();
+	else
+		logger->warn("WusbStack destroyed by its own I/O thread!");
 	if ( messageBuffer ) delete messageBuffer;
+	messageBuffer = NULL;
+	if ( receiverThread->isRunning() )
+		receiverThread->deleteLater();
+	else
+		delete receiverThread;
+	delete urbScheduler;
+	// buffers still used by URB receiver are given back later
+	smallURBpool->dispose();
+	largeURBpool->dispose();
 }
 
 Logger * WusbStack::getLogger() {
 	return logger;
 }
 
+PooledBuffer WusbStack::allocateURBBuffer( int size ) {
+	if ( size <= smallURBpool->getBlockSize() )
+		return smallURBpool->acquire( size );
+	if ( size <= largeURBpool->getBlockSize() )
+		return largeURBpool->acquire( size );
+	// very big URB: not pooled
+	return PooledBuffer::allocate( size );
+}
+
+PooledBuffer WusbStack::allocateAnswerBuffer( int size, unsigned int packetID ) {
+	if ( urbReceiver && packetID && packetRefDataByPacketID.contains( packetID ) ) {
+		PooledBuffer buffer = urbReceiver->reserveAnswerBuffer( packetRefDataByPacketID[ packetID ], size );
+		if ( !buffer.isNull() ) return buffer;
+	}
+	return allocateURBBuffer( size );
+}
+
+int WusbStack::maxAnswerLength( unsigned int packetID ) const {
+	if ( !answerLengthByPacketID.contains( packetID ) )
+		return WUSB_AZUREWAVE_MAX_UNKNOWN_ANSWER_LEN;
+	return qMax( answerLengthByPacketID.value( packetID ), maxMTU );
+}
+
 bool WusbStack::openSocket() {
 	if ( logger->isDebugEnabled() )
 		logger->debug("Open connection..." );
 	// Clean up socket if necessary
-	if ( udpSocket ) {
-		disconnect( udpSocket, SIGNAL( readyRead() ), this, SLOT(processPendingData() ) );
-		udpSocket->close();
-		udpSocket = NULL;
+	if ( dataChannel ) {
+		disconnect( dataChannel, SIGNAL( readyRead() ), this, SLOT(processPendingData() ) );
+		dataChannel->close();
+		delete dataChannel;
+		dataChannel = NULL;
 	}
 	// open the socket and binding to an interface
-	udpSocket = new QUdpSocket( this );
-	if ( !udpSocket->bind( QHostAddress::Any, 0, QUdpSocket::DefaultForPlatform ) ) {	// XXX binding to a specific port is not necessary !!!???
-		logger->warn(QString("Cannot bind to interface: %1").arg(udpSocket->errorString()) );
+	dataChannel = new WusbDatagramChannel( logger, WUSB_DATAGRAM_DEFAULT_RECEIVE_SLOTS, WUSB_DATAGRAM_DEFAULT_SLOT_SIZE, this );
+	if ( !dataChannel->open( destAddress, destPort ) ) {
+		logger->warn(QString("Cannot open data channel: %1").arg(dataChannel->errorString()) );
+		delete dataChannel;
+		dataChannel = NULL;
 		return false;
 	}
 
 	// connecting a callback to get informed if data is available
-	connect( udpSocket, SIGNAL( readyRead() ),
+	connect( dataChannel, SIGNAL( readyRead() ),
 			this, SLOT(processPendingData()));
+	initSendMTU();
 	return true;
 }
 
-bool WusbStack::writeToSocket( const QByteArray & buffer ) {
-//	logger->debug(QString("Want to write %1 bytes to socket").arg( QString::number(buffer.size())));
-	sendBufferMutex.lock();
+void WusbStack::initSendMTU() {
+	sendMTU = configuredMTU;
+	sendMTUconfirmed = true;
+	if ( !mtuDiscovery || !dataChannel ) return;
+
+	// packets are never fragmented: too big packets are reported by kernel (EMSGSIZE)
+	dataChannel->setPathMTUDiscovery( true );
+	int pathMTU = dataChannel->pathMTU();
+	if ( hubMTU > 0 )
+		sendMTU = hubMTU;		// result of previous discovery
+	else if ( pathMTU > sendMTU ) {
+		// probe: hub has to acknowledge a packet of this size
+		sendMTU = pathMTU;
+		sendMTUconfirmed = false;
+	}
+	// network path may have changed since last connection
+	if ( pathMTU > 0 && pathMTU < sendMTU )
+		sendMTU = pathMTU;
+	sendMTU = qBound( WUSB_AZUREWAVE_NETWORK_MIN_MTU, sendMTU, WUSB_AZUREWAVE_NETWORK_MAX_MTU );
+	if ( sendMTU <= WUSB_AZUREWAVE_NETWORK_DEFAULT_MTU )
+		sendMTUconfirmed = true;
+	if ( logger->isInfoEnabled() )
+		logger->info(QString("Packet size to hub: %1 bytes (path MTU: %2, %3)").arg( QString::number( sendMTU ),
+				QString::number( pathMTU ), sendMTUconfirmed? QString("confirmed") : QString("probing") ) );
+}
 
-	int bufSize = buffer.size();
-	qint64 retVal = udpSocket->writeDatagram( buffer, destAddress, destPort );
-	if ( logger->isTraceEnabled() )
-		logger->trace(QString("Wrote %1 bytes (of %2) on network").arg( QString::number( retVal ), QString::number( bufSize ) ) );
+void WusbStack::confirmSendMTU( bool accepted ) {
+	if ( sendMTUconfirmed ) return;
+	sendMTUconfirmed = true;
+	if ( accepted )
+		logger->info(QString("Hub accepts packets of %1 bytes").arg( QString::number( sendMTU ) ) );
+	else {
+		logger->warn(QString("Hub does not acknowledge packets of %1 bytes - falling back to %2 bytes").arg(
+				QString::number( sendMTU ), QString::number( WUSB_AZUREWAVE_NETWORK_DEFAULT_MTU ) ) );
+		sendMTU = WUSB_AZUREWAVE_NETWORK_DEFAULT_MTU;
+	}
+	// result is persisted by thread closing the connection (config is not accessed by I/O thread)
+	hubMTU = sendMTU;
+	hubMTUchanged = true;
+}
 
-	sendBufferMutex.unlock();
-	return true;
+void WusbStack::reduceSendMTU() {
+	int pathMTU = dataChannel? dataChannel->pathMTU() : -1;
+	int newMTU = ( pathMTU > 0 && pathMTU < sendMTU )? pathMTU : WUSB_AZUREWAVE_NETWORK_DEFAULT_MTU;
+	newMTU = qMax( newMTU, (int) WUSB_AZUREWAVE_NETWORK_MIN_MTU );
+	if ( newMTU >= sendMTU ) return;
+	logger->warn(QString("Packet of %1 bytes too big for network path - reduced to %2 bytes").arg(
+			QString::number( sendMTU ), QString::number( newMTU ) ) );
+	sendMTU = newMTU;
+	sendMTUconfirmed = true;
+	if ( mtuDiscovery ) {
+		hubMTU = sendMTU;
+		hubMTUchanged = true;
+	}
+}
+
+bool WusbStack::writeToSocket( const QByteArray & buffer ) {
+	if ( !dataChannel ) return false;
+	QMutexLocker locker( &sendBufferMutex );
+	if ( !dataChannel->queueDatagram( buffer.constData(), buffer.size() ) ) {
+		dataChannel->discardQueued();
+		return false;
+	}
+	return dataChannel->flush();
 }
 
 
 bool WusbStack::openDevice() {
-	if ( !udpSocket || state == STATE_OPENED || state == STATE_DISCONNECTED || state == STATE_FAILED ) return false;
+	if ( !dataChannel || state == STATE_OPENED || state == STATE_DISCONNECTED || state == STATE_FAILED ) return false;
 
 	haveAnswer = false;
 
@@ -131,7 +301,7 @@ bool WusbStack::openDevice() {
 }
 
 bool WusbStack::closeDevice() {
-	if ( !udpSocket || state == STATE_CLOSED || state == STATE_DISCONNECTED || state == STATE_FAILED ) return false;
+	if ( !dataChannel || state == STATE_CLOSED || state == STATE_DISCONNECTED || state == STATE_FAILED ) return false;
 
 	haveAnswer = false;
 	stopTimer();
@@ -151,120 +321,386 @@ void WusbStack::stopTimer() {
 		delete connectionKeeperTimer;
 		connectionKeeperTimer = NULL;
 	}
+	if (ackTimer) {
+		ackTimer->stop();
+		disconnect( ackTimer, SIGNAL(timeout()), this, SLOT(sendPendingAcknowledge()) );
+		delete ackTimer;
+		ackTimer = NULL;
+	}
+	ackPending = false;
+	if (retransmitTimer) {
+		retransmitTimer->stop();
+		disconnect( retransmitTimer, SIGNAL(timeout()), this, SLOT(retransmitTimeout()) );
+		delete retransmitTimer;
+		retransmitTimer = NULL;
+	}
 }
 
 
 bool WusbStack::openConnection() {
 	if ( state == STATE_CONNECTED || state == STATE_OPENED ) return false;
-	// open/create socket and connect to device
-	if ( openSocket() ) {
-		state = STATE_CONNECTED;	// State -> connected
-		// start protocol thread handler
-		if ( openDevice() ) {
-			int waitCount = 0;
-			while( waitCount < 300 && state != STATE_OPENED ) {
-				QCoreApplication::processEvents();	// process pending events
-				sleepThread( 10L );
-				waitCount++;
-			}
-			if ( state == STATE_OPENED ) {
-				connectionKeeperTimer = new QTimer(this);
-				connect(connectionKeeperTimer, SIGNAL(timeout()), this, SLOT(timerInterrupt()));
-				connectionKeeperTimer->start( WUSB_AZUREWAVE_TIMER_INTERVAL );
-				return true;
-			} else
-				return false;
-		} else {
-			state = STATE_FAILED;
-			return false;
-		}
+	if ( QThread::currentThread() == receiverThread ) {
+		logger->error("WusbStack::openConnection() must not be called in I/O thread of stack");
+		return false;
 	}
-	return false;
+	// state of a previous (failed) connection must not be taken as answer
+	setState( STATE_DISCONNECTED );
+	// open/create socket and connect to device (this is done in I/O thread)
+	QMetaObject::invokeMethod( this, "openConnectionInternal", Qt::QueuedConnection );
+	// and wait for answer of device
+	return waitForState( STATE_OPENED, WUSB_AZUREWAVE_TIMER_OPEN_TIMEOUT );
+}
+
+void WusbStack::openConnectionInternal() {
+	// new connection: receive window and reassembly start from scratch
+	messageBuffer->reset();
+	// TANs of a new session start like the ones of a new stack (first packet is sent with TAN 0xff)
+	currentSendTransactionNum = -1;
+	currentReceiveTransactionNum = 0;
+	currentTransactionNum = 0xff;
+	sendPacketCounter = 0;
+	lastPacketSendTimeMillis = 0L;
+	lastPacketReceiveTimeMillis = 0L;
+	lastSendAlivePacket = 0L;
+	// round trip time of a previous connection may not apply anymore (e.g. other network path)
+	srttMillis = 0;
+	rttVarMillis = 0;
+	haveRTTsample = false;
+	rtoMillis = qBound( minRTOMillis, WUSB_AZUREWAVE_INITIAL_RTO, maxRTOMillis );
+	if ( openSocket() ) {
+		setState( STATE_CONNECTED );	// State -> connected
+		if ( !openDevice() )
+			setState( STATE_FAILED );
+	} else
+		setState( STATE_FAILED );
+}
+
+void WusbStack::startConnectionTimers() {
+	if ( connectionKeeperTimer ) return;
+	connectionKeeperTimer = new QTimer(this);
+	connect(connectionKeeperTimer, SIGNAL(timeout()), this, SLOT(timerInterrupt()));
+	connectionKeeperTimer->start( WUSB_AZUREWAVE_TIMER_INTERVAL );
+	ackTimer = new QTimer(this);
+	ackTimer->setSingleShot( true );
+	connect(ackTimer, SIGNAL(timeout()), this, SLOT(sendPendingAcknowledge()));
+	retransmitTimer = new QTimer(this);
+	retransmitTimer->setSingleShot( true );
+	connect(retransmitTimer, SIGNAL(timeout()), this, SLOT(retransmitTimeout()));
 }
 
 bool WusbStack::closeConnection() {
 	if ( state == STATE_DISCONNECTED ) return false;
+	if ( QThread::currentThread() == receiverThread ) {
+		// called from I/O thread: we cannot wait for acknowledge of device
+		closeDeviceInternal();
+		closeSocket();
+		return true;
+	}
 
 	// close connection to device
-	if ( closeDevice() ) {
-		// give network device some time to acknoledge
-		int waitCount = 0;
-		while( waitCount < 100 && state != STATE_CLOSED && state != STATE_FAILED ) {
-			QCoreApplication::processEvents();	// process pending events
-			sleepThread( 50L );
-			waitCount++;
-		}
-	}
+	closeRequestSent = false;
+	QMetaObject::invokeMethod( this, "closeDeviceInternal", Qt::BlockingQueuedConnection );
+	if ( closeRequestSent )
+		// give network device some time to acknowledge
+		waitForState( STATE_CLOSED, WUSB_AZUREWAVE_TIMER_CLOSE_TIMEOUT );
 
 	// and close the socket
-	if ( udpSocket ) {
-		disconnect( udpSocket, SIGNAL( readyRead() ), this, SLOT(processPendingData() ) );
-		if ( udpSocket->isOpen() )
-			udpSocket->close();
-		delete udpSocket;
-		udpSocket = NULL;
+	QMetaObject::invokeMethod( this, "closeSocket", Qt::BlockingQueuedConnection );
+
+	// I/O thread is idle now: remember discovered packet size of hub for next connection
+	if ( hubMTUchanged ) {
+		ConfigManager::getInstance().setIntValue( hubMTUkey, hubMTU );
+		hubMTUchanged = false;
 	}
 	return true;
 }
 
-void WusbStack::processPendingData() {
-	if ( !udpSocket ) return;
-	while ( udpSocket->hasPendingDatagrams() ) {
-		QByteArray datagram = QByteArray();
-		datagram.resize( udpSocket->pendingDatagramSize() );
+void WusbStack::closeDeviceInternal() {
+	// URBs not sent until now will never be answered
+	discardPendingURBs();
+	closeRequestSent = closeDevice();
+}
 
-		QHostAddress sender;
-		quint16 senderPort;
-		qint64 bytesRead = udpSocket->readDatagram(datagram.data(), datagram.size(),
-				&sender, &senderPort);
+void WusbStack::closeSocket() {
+	stopTimer();
+	if ( dataChannel ) {
+		disconnect( dataChannel, SIGNAL( readyRead() ), this, SLOT(processPendingData() ) );
+		dataChannel->close();
+		delete dataChannel;
+		dataChannel = NULL;
+	}
+}
 
-		if ( bytesRead > 0 ) {
-			if ( logger->isTraceEnabled() )
-				logger->trace(QString("Received %1 bytes from network: %2").arg( QString::number(bytesRead), WusbHelperLib::messageToString( datagram, bytesRead )) );
-
-			if ( datagram.size() > maxMTU ) {
-				// remote device sent faster than we could receive or process
-				// -> multiple messages are concatuated in buffer
-				//    -> process all parts individual
-				int idx = 0;
-				do {
-					emit receivedUDPdata( datagram.mid(idx, maxMTU) );
-					idx += maxMTU;
-				} while( idx < datagram.size() );
-			} else
-				emit receivedUDPdata( datagram );
-		}
+bool WusbStack::suspendConnection() {
+	if ( state != STATE_OPENED ) return false;
+	if ( QThread::currentThread() == receiverThread )
+		suspendConnectionInternal();
+	else
+		QMetaObject::invokeMethod( this, "suspendConnectionInternal", Qt::BlockingQueuedConnection );
+	return true;
+}
+
+void WusbStack::suspendConnectionInternal() {
+	// URBs posted to channel stay there until channel is attached again
+	if ( urbChannelNotifier ) {
+		urbChannelNotifier->setEnabled( false );
+		delete urbChannelNotifier;
+		urbChannelNotifier = NULL;
+	}
+	urbChannel = NULL;
+	urbChannelToAttach = NULL;
+	// answers of URBs sent are lost with connection - queued URBs are sent on next open
+	discardURBsInFlight();
+	closeSocket();
+	setState( STATE_CLOSED );
+	if ( logger->isInfoEnabled() )
+		logger->info(QString("Connection suspended (%1 URBs kept in send queue)").arg(
+				QString::number( urbScheduler->size() ) ) );
+}
+
+void WusbStack::setState( eStackState newState ) {
+	QMutexLocker locker( &stateMutex );
+	state = newState;
+	stateChanged.wakeAll();
+}
+
+bool WusbStack::waitForState( eStackState wantedState, unsigned long timeoutMillis ) {
+	QMutexLocker locker( &stateMutex );
+	long long deadline = currentTimeMillis() + timeoutMillis;
+	while ( state != wantedState && state != STATE_FAILED ) {
+		long long now = currentTimeMillis();
+		if ( now >= deadline ) break;
+		stateChanged.wait( &stateMutex, (unsigned long) (deadline - now) );
 	}
+	return state == wantedState;
 }
 
-void WusbStack::socketError(QAbstractSocket::SocketError socketError) {
-	// TODO check/process socket error condition
-	// since communication is based on UDP - unclear if/when this error may occur
-	// -> reboot of remote hub and receive of "port unreachable" ICMP?
-	logger->error( QString::fromAscii("Socket error in communication with remote hub %1:%2 - error: %3 (%4)").arg(
-			destAddress.toString(), QString::number(destPort), QString::number(socketError), udpSocket->errorString() ) );
+void WusbStack::processPendingData() {
+	if ( !dataChannel ) return;
+	// drain socket: every call reads a batch of datagrams with a single system call
+	int numDatagrams;
+	while ( dataChannel && ( numDatagrams = dataChannel->receiveBatch() ) > 0 ) {
+		for ( int i = 0; i < numDatagrams; i++ ) {
+			int bytesRead = dataChannel->receivedLength( i );
+			if ( bytesRead <= 0 ) continue;
+			// datagram is processed in place (receive slot of channel)
+			const char * datagram = dataChannel->receivedData( i );
+
+			if ( logger->isTraceEnabled() )
+				logger->trace(QString("Received %1 bytes from network: %2").arg( QString::number(bytesRead),
+						WusbHelperLib::messageToString( (const uint8_t*) datagram, bytesRead )) );
+
+			// remote device may send faster than we could receive or process
+			// -> multiple messages are concatuated in buffer
+			//    -> process all parts individual
+			int idx = 0;
+			do {
+				messageBuffer->receive( datagram + idx, qMin( maxMTU, bytesRead - idx ) );
+				idx += maxMTU;
+			} while( idx < bytesRead );
+		}
+	}
 }
 
 void WusbStack::timerInterrupt() {
-	// This is called every 100ms to check if idle/keep-alive messages are neccessary to send
+	// This is called periodically to check if keep-alive messages are neccessary to send
 	long long now = currentTimeMillis();
 	long long lastPacketTime = qMax( lastPacketSendTimeMillis, lastPacketReceiveTimeMillis );
 
 	// sanity check
-	if ( !udpSocket || state != STATE_OPENED || lastPacketSendTimeMillis == 0L ) return;
+	if ( !dataChannel || state != STATE_OPENED || lastPacketSendTimeMillis == 0L ) return;
+
+	// isochronous URBs without answer are given back (with all frames failed)
+	expireIsoURBs( now );
+	// packets held back behind a packet which is never received are processed after a while
+	messageBuffer->checkReceiveWindowTimeout( now );
+
+	// free slots of send window which are occupied by URBs never acknowledged by hub
+	if ( !urbsInFlight.isEmpty() ) {
+		QList<unsigned int> timedOutPackets;
+		QHashIterator<unsigned int, InFlightURB_t> it( urbsInFlight );
+		while ( it.hasNext() ) {
+			it.next();
+			if ( it.value().sendTimeMillis > now || now - it.value().sendTimeMillis > WUSB_AZUREWAVE_TIMER_URB_TIMEOUT )
+				timedOutPackets.append( it.key() );
+		}
+		for ( int i = 0; i < timedOutPackets.size(); i++ ) {
+			const InFlightURB_t & urb = urbsInFlight[ timedOutPackets[i] ];
+			// probed packet size is never acknowledged: hub (or network) drops these packets
+			if ( !sendMTUconfirmed && urb.ackedPackets == 0 && urb.packetCount > 1 &&
+					urb.firstPayloadLen + WUSB_AZUREWAVE_SEND_HEADER_LEN == sendMTU )
+				confirmSendMTU( false );
+			urbsUnacknowledged++;
+			logger->warn(QString("URB (ID = 0x%1) not acknowledged by hub (%2 of %3 packets) - removed from send window "
+					"(%4 URBs so far)").arg( QString::number( timedOutPackets[i], 16 ), QString::number( urb.ackedPackets ),
+					QString::number( urb.packetCount ), QString::number( urbsUnacknowledged ) ) );
+			// URB is still outstanding for host: an answer of hub is given back when it arrives
+			completeSentURB( timedOutPackets[i] );
+		}
+		if ( !timedOutPackets.isEmpty() )
+			flushSendQueue();
+	}
+
+	// Acknowledge of received messages is scheduled on receive (see scheduleAcknowledge()).
+	// Here we only need to send idle messages when no real communcation is needed (a.k.a. keep alive)
+	// (and workaround for clock warping...)
+	if ( ( lastPacketTime > now || now - lastPacketTime >= WUSB_AZUREWAVE_TIMER_SEND_KEEP_ALIVE ) &&
+			( lastSendAlivePacket > now || now - lastSendAlivePacket >= WUSB_AZUREWAVE_TIMER_SEND_KEEP_ALIVE ) )
+		sendIdleMessage();
+}
+
+void WusbStack::acknowledgeSentPackets( uint8_t nextExpectedTAN ) {
+	if ( urbsInFlight.isEmpty() ) return;
+	long long now = currentTimeMillis();
+	QList<unsigned int> completedPackets;
+	QMutableHashIterator<unsigned int, InFlightURB_t> it( urbsInFlight );
+	while ( it.hasNext() ) {
+		it.next();
+		InFlightURB_t & urb = it.value();
+		// number of packets of URB received by hub - an ack "behind" URB (more than half TAN space
+		// ahead) refers to packets sent before this URB
+		int acked = ( nextExpectedTAN - urb.firstSendTAN + 256 ) % 256;
+		if ( acked >= 128 ) continue;
+		if ( acked > urb.packetCount ) acked = urb.packetCount;
+		if ( acked <= urb.ackedPackets ) continue;
+
+		// Karn's rule: an ack of a retransmitted packet may belong to any of its transmissions
+		if ( urb.retransmitCount == 0 && urb.ackedPackets == 0 && now >= urb.sendTimeMillis )
+			updateRetransmitTimeout( now - urb.sendTimeMillis );
+		// first packet of a multi packet URB has full size: probed packet size works
+		if ( !sendMTUconfirmed && urb.packetCount > 1 &&
+				urb.firstPayloadLen + WUSB_AZUREWAVE_SEND_HEADER_LEN == sendMTU )
+			confirmSendMTU( true );
+		urb.ackedPackets = acked;
+		if ( urb.ackedPackets == urb.packetCount && retransmitEnabled )
+			completedPackets.append( it.key() );
+	}
+	// hub has got everything - slot of send window is free (answer is still awaited)
+	// - only if acknowledges are trusted (see retransmitEnabled)
+	for ( int i = 0; i < completedPackets.size(); i++ )
+		completeSentURB( completedPackets[i] );
+	scheduleRetransmit();
+}
+
+void WusbStack::completeSentURB( unsigned int packetID ) {
+	if ( !urbsInFlight.contains( packetID ) ) return;
+	InFlightURB_t urb = urbsInFlight.take( packetID );
+	// URB data is not needed anymore
+	if ( urb.urbData ) delete urb.urbData;
+	urbsAwaitingAnswer.insert( packetID, urb.sendTimeMillis );
+}
+
+void WusbStack::updateRetransmitTimeout( long long rttMillis ) {
+	int rtt = (int) qMin( rttMillis, (long long) maxRTOMillis );
+	// Jacobson/Karels estimation of round trip time and its variation (see RFC 6298)
+	if ( !haveRTTsample ) {
+		srttMillis = rtt;
+		rttVarMillis = rtt / 2;
+		haveRTTsample = true;
+	} else {
+		rttVarMillis = ( 3 * rttVarMillis + qAbs( srttMillis - rtt ) ) / 4;
+		srttMillis = ( 7 * srttMillis + rtt ) / 8;
+	}
+	rtoMillis = qBound( minRTOMillis, srttMillis + qMax( 1, 4 * rttVarMillis ), maxRTOMillis );
+	if ( logger->isTraceEnabled() )
+		logger->trace(QString("RTT sample %1 ms: SRTT=%2 RTTVAR=%3 RTO=%4").arg( QString::number( rtt ),
+				QString::number( srttMillis ), QString::number( rttVarMillis ), QString::number( rtoMillis ) ) );
+}
+
+void WusbStack::scheduleRetransmit() {
+	if ( !retransmitTimer || !retransmitEnabled ) return;
+	long long deadline = -1L;
+	QHashIterator<unsigned int, InFlightURB_t> it( urbsInFlight );
+	while ( it.hasNext() ) {
+		it.next();
+		const InFlightURB_t & urb = it.value();
+		if ( !urb.urbData || urb.retransmitCount >= WUSB_AZUREWAVE_MAX_RETRANSMIT ) continue;
+		// exponential backoff of retransmissions
+		long long urbDeadline = urb.lastTransmitMillis + qMin( rtoMillis << urb.retransmitCount, maxRTOMillis );
+		if ( deadline < 0L || urbDeadline < deadline )
+			deadline = urbDeadline;
+	}
+	if ( deadline < 0L ) {
+		retransmitTimer->stop();
+		return;
+	}
+	long long now = currentTimeMillis();
+	retransmitTimer->start( deadline > now? (int) ( deadline - now ) : 0 );
+}
+
+void WusbStack::retransmitTimeout() {
+	if ( !dataChannel || state != STATE_OPENED || !retransmitEnabled ) return;
+	long long now = currentTimeMillis();
+	QMutableHashIterator<unsigned int, InFlightURB_t> it( urbsInFlight );
+	while ( it.hasNext() ) {
+		it.next();
+		InFlightURB_t & urb = it.value();
+		if ( !urb.urbData || urb.retransmitCount >= WUSB_AZUREWAVE_MAX_RETRANSMIT ) continue;
+		if ( urb.lastTransmitMillis + qMin( rtoMillis << urb.retransmitCount, maxRTOMillis ) > now ) continue;
+		// probed packet size is never acknowledged: hub (or network) drops these packets
+		if ( !sendMTUconfirmed && urb.ackedPackets == 0 && urb.packetCount > 1 &&
+				urb.firstPayloadLen + WUSB_AZUREWAVE_SEND_HEADER_LEN == sendMTU &&
+				urb.retransmitCount >= WUSB_AZUREWAVE_MTU_PROBE_RETRANSMIT )
+			confirmSendMTU( false );
+		if ( logger->isDebugEnabled() )
+			logger->debug(QString("Retransmit URB (ID = 0x%1): packets %2..%3 of %4 (RTO=%5 ms)").arg(
+					QString::number( it.key(), 16 ), QString::number( urb.ackedPackets + 1 ),
+					QString::number( urb.packetCount ), QString::number( urb.packetCount ),
+					QString::number( rtoMillis ) ) );
+		retransmitPackets( urb );
+	}
+	scheduleRetransmit();
+}
 
-//	if ( lastPacketReceiveTimeMillis > now || now - lastPacketReceiveTimeMillis > )
+void WusbStack::retransmitPackets( InFlightURB_t & urb ) {
+	const char * payload = urb.urbData->constData();
+	int urbLen = urb.urbData->length();
+	const char * headers = urb.headers.constData();
+
+	// only packets not acknowledged are sent again - with their original headers (and TANs)
+	QMutexLocker locker( &sendBufferMutex );
+	bool res = true;
+	for ( int i = urb.ackedPackets; i < urb.packetCount && res; i++ ) {
+		if ( i == 0 ) {
+			res = dataChannel->queueDatagram( headers, WUSB_AZUREWAVE_SEND_HEADER_LEN, payload, urb.firstPayloadLen );
+		} else {
+			int idx = urb.firstPayloadLen + ( i - 1 ) * urb.subsqPayloadLen;
+			res = dataChannel->queueDatagram( headers + WUSB_AZUREWAVE_SEND_HEADER_LEN + ( i - 1 ) * WUSB_AZUREWAVE_SEND_SUBSQ_HEADER_LEN,
+					WUSB_AZUREWAVE_SEND_SUBSQ_HEADER_LEN, payload + idx, qMin( urb.subsqPayloadLen, urbLen - idx ) );
+		}
+	}
+	// an implicit flush failed: rest of packets is sent with next retransmission
+	if ( !res )
+		dataChannel->discardQueued();
+	else
+		res = dataChannel->flush();
+	if ( !res && dataChannel->lastSendTooBig() )
+		reduceSendMTU();
+	urb.retransmitCount++;
+	urb.lastTransmitMillis = currentTimeMillis();
+	lastPacketSendTimeMillis = urb.lastTransmitMillis;
+}
 
-	// Since more than 100ms nothing sent? (and workaround for clock warping...)
-	// We need to send idle (or receive OK) messages:
-	// - when no real communcation is needed (a.k.a. keep alive)  (2 secs)
-	// - when we received a message from hub but have no new message to send (receive ack) (>100ms)
-	if ( lastPacketTime > now || now - lastPacketTime > WUSB_AZUREWAVE_TIMER_SEND_ACK ) {
-		if ( lastSendAlivePacket < lastPacketTime )
-			sendAcknowledgeReplyMessage();
-		else if ( now - lastSendAlivePacket >= WUSB_AZUREWAVE_TIMER_SEND_KEEP_ALIVE )
-			sendIdleMessage();
+void WusbStack::scheduleAcknowledge() {
+	ackPending = true;
+	if ( ackDelayMillis <= 0 || !ackTimer ) {
+		sendPendingAcknowledge();
+		return;
 	}
+	// deadline is armed by first unacknowledged packet - subsequent packets are coalesced
+	if ( !ackTimer->isActive() )
+		ackTimer->start( ackDelayMillis );
+}
+
+void WusbStack::clearPendingAcknowledge() {
+	ackPending = false;
+	if ( ackTimer && ackTimer->isActive() )
+		ackTimer->stop();
+}
+
+void WusbStack::sendPendingAcknowledge() {
+	if ( !ackPending ) return;
+	sendAcknowledgeReplyMessage();
 }
 
 bool WusbStack::sendURB (
@@ -293,35 +729,310 @@ bool WusbStack::sendURB (
 		uint8_t intervalVal,
 		int receiveLength ) {
 
-	int packetLen =	urbData->length() + WUSB_AZUREWAVE_SEND_HEADER_LEN;	// +28 bytes header
-
-	QLinkedList<QByteArray> messageSplit;
-	if ( packetLen > maxMTU ) {
-		// we need to split the message!
-		// only the first message part will be complete (with all header parts)
-		// subsequent message are composed of transaction header (with incremented send no.) and payload
-
-		packetLen = maxMTU;
-
-		// first packet: length = MTU - header
-		messageSplit.append( urbData->left( maxMTU - WUSB_AZUREWAVE_SEND_HEADER_LEN ) );
-		// subsequent packets:
-		bool done = false;
-		int idx = maxMTU - WUSB_AZUREWAVE_SEND_HEADER_LEN;	// first position of next packet
-		int len = maxMTU - WUSB_AZUREWAVE_SEND_SUBSQ_HEADER_LEN;	// length of packet
-		do {
-			messageSplit.append( urbData->mid( idx, len ) );
-			if ( idx + len >= urbData->length() )	// last packet
-				done = true;
-			idx += len;
-		} while ( !done );
+	if ( !urbData ) return false;
+
+	PendingURB_t urb;
+	urb.refData = refData;
+	urb.urbData = urbData;
+	urb.dataTransferType = dataTransferType;
+	urb.directionType = directionType;
+	urb.endpoint = endpoint;
+	urb.transferFlags = transferFlags;
+	urb.intervalVal = intervalVal;
+	urb.receiveLength = receiveLength;
+	urb.deadlineMillis = 0L;
+	// (number of frames is known from packet table only)
+	if ( dataTransferType == ISOCHRONOUS_TRANSFER && isoPacketTable ) {
+		// frames of URB have to be transmitted before they are played/recorded:
+		// URB may wait as long as its packets last (interval given in frames - 1 ms at full speed)
+		int packetCount = 0;
+		if ( urbData->size() >= WUSB_ISO_TABLE_HEADER_LEN ) {
+			const uint8_t * table = (const uint8_t *) urbData->constData();
+			packetCount = table[0] | ( table[1] << 8 ) | ( table[2] << 16 ) | ( table[3] << 24 );
+		}
+		urb.deadlineMillis = currentTimeMillis() +
+				qMax( WUSB_AZUREWAVE_ISO_MIN_DEADLINE, packetCount * qMax( 1, (int) intervalVal ) );
+	}
+
+	urbSendQueueMutex.lock();
+	urbScheduler->enqueue( urb );
+	urbSendQueueMutex.unlock();
+	if ( QThread::currentThread() == receiverThread ) {
+		// URBs taken from URB channel are sent together after channel is drained
+		if ( !takingURBrequests )
+			flushSendQueue();
+	} else
+		// URB is transmitted by I/O thread of stack
+		QMetaObject::invokeMethod( this, "flushSendQueue", Qt::QueuedConnection );
+	return dataChannel != NULL;
+}
+
+void WusbStack::flushSendQueue() {
+	flushSendQueuePosted = false;
+	if ( !dataChannel ) return;
+	// bulk URBs never take the last slots of send window
+	int bulkWindowSize = sendWindowSize > WUSB_AZUREWAVE_PRIORITY_WINDOW_SLOTS?
+			sendWindowSize - WUSB_AZUREWAVE_PRIORITY_WINDOW_SLOTS : sendWindowSize;
+	urbSendQueueMutex.lock();
+	urbScheduler->startRound();
+	urbSendQueueMutex.unlock();
+	while ( true ) {
+		PendingURB_t urb;
+		urbSendQueueMutex.lock();
+		// isochronous URBs are not answered individually - they do not occupy a slot in send window
+		// (URBs waiting for packing into next datagram do)
+		int windowUsed = urbsInFlight.size() + coalesceBatch.size();
+		bool haveURB = urbScheduler->dequeue( urb, windowUsed < sendWindowSize, windowUsed < bulkWindowSize );
+		urbSendQueueMutex.unlock();
+		if ( !haveURB )
+			break;	// nothing to send or window is full: wait for next answer from hub
+
+		if ( urb.deadlineMillis > 0L && currentTimeMillis() > urb.deadlineMillis ) {
+			// isochronous frames are too late: drop them instead of delaying following frames
+			isoURBsDropped++;
+			if ( logger->isDebugEnabled() )
+				logger->debug(QString("Isochronous URB too late - dropped (%1 dropped so far)").arg(
+						QString::number( isoURBsDropped ) ) );
+			if ( urbReceiver && urb.refData )
+				urbReceiver->giveBackAnswerURB( urb.refData, false, NULL );
+			delete urb.urbData;
+			continue;
+		}
+
+		if ( coalesceSmallURBs && urb.urbData->size() <= WUSB_AZUREWAVE_COALESCE_MAX_URB_LEN &&
+				( urb.dataTransferType == INTERRUPT_TRANSFER || urb.dataTransferType == BULK_TRANSFER ) ) {
+			int packetLen = WUSB_AZUREWAVE_SEND_HEADER_LEN + urb.urbData->size();
+			if ( coalesceBatchLen + packetLen > sendMTU )
+				transmitCoalescedURBs();
+			coalesceBatch.append( urb );
+			coalesceBatchLen += packetLen;
+			continue;
+		}
+		// URBs packed so far are sent first (URBs are written to network in scheduled order)
+		transmitCoalescedURBs();
+
+		// isochronous URBs are never retransmitted - data would be too late anyway
+		if ( urb.dataTransferType != ISOCHRONOUS_TRANSFER ) {
+			InFlightURB_t inFlight;
+			unsigned int packetID = transmitURB( urb, &inFlight );
+			if ( packetID ) {
+				urbsInFlight.insert( packetID, inFlight );
+				continue;
+			}
+		} else {
+			unsigned int packetID = transmitURB( urb, NULL );
+			if ( packetID ) {
+				isoURBsInFlight.insert( packetID, lastPacketSendTimeMillis );
+				delete urb.urbData;
+				continue;
+			}
+		}
+		// URB could not be written to network: there will be no answer
+		if ( urbReceiver && urb.refData )
+			urbReceiver->giveBackAnswerURB( urb.refData, false, NULL );
+		delete urb.urbData;
+	}
+	transmitCoalescedURBs();
+	scheduleRetransmit();
+
+	// bulk budget used up: URBs posted meanwhile (e.g. interrupt URBs) get a chance before next bulk URBs
+	urbSendQueueMutex.lock();
+	bool continueBulk = urbScheduler->isBulkBudgetExhausted() && urbsInFlight.size() < bulkWindowSize;
+	urbSendQueueMutex.unlock();
+	if ( continueBulk && !flushSendQueuePosted ) {
+		flushSendQueuePosted = true;
+		QMetaObject::invokeMethod( this, "flushSendQueue", Qt::QueuedConnection );
+	}
+	if ( logger->isTraceEnabled() )
+		logger->trace(QString("Send window: %1 URBs in flight, %2 URBs awaiting answer, %3 URBs queued").arg(
+				QString::number( urbsInFlight.size() ), QString::number( urbsAwaitingAnswer.size() ),
+				QString::number( urbScheduler->size() ) ) );
+}
+
+void WusbStack::releaseSendWindowSlot( unsigned int packetID ) {
+	urbsAwaitingAnswer.remove( packetID );
+	if ( !urbsInFlight.contains( packetID ) ) return;
+	InFlightURB_t urb = urbsInFlight.take( packetID );
+	if ( urb.urbData ) delete urb.urbData;
+}
+
+void WusbStack::discardPendingURBs() {
+	urbSendQueueMutex.lock();
+	QList<PendingURB_t> discardedURBs = urbScheduler->takeAll();
+	urbSendQueueMutex.unlock();
+	while ( !discardedURBs.isEmpty() ) {
+		PendingURB_t urb = discardedURBs.takeFirst();
+		if ( urbReceiver && urb.refData )
+			urbReceiver->giveBackAnswerURB( urb.refData, false, NULL );
+		delete urb.urbData;
+	}
+	discardURBsInFlight();
+}
+
+void WusbStack::discardURBsInFlight() {
+	// URBs in flight: no more retransmissions
+	QHashIterator<unsigned int, InFlightURB_t> it( urbsInFlight );
+	while ( it.hasNext() ) {
+		it.next();
+		if ( it.value().urbData ) delete it.value().urbData;
+	}
+	urbsInFlight.clear();
+	urbsAwaitingAnswer.clear();
+	isoURBsInFlight.clear();
+	if ( retransmitTimer ) retransmitTimer->stop();
+	failOutstandingURBs();
+}
+
+void WusbStack::failOutstandingURBs() {
+	// answers in reassembly must not be written to URB buffers given back
+	messageBuffer->detachAnswerBuffers();
+	QHashIterator<unsigned int, void*> it( packetRefDataByPacketID );
+	while ( it.hasNext() ) {
+		it.next();
+		if ( urbReceiver && it.value() )
+			urbReceiver->giveBackAnswerURB( it.value(), false, NULL );
+	}
+	packetRefDataByPacketID.clear();
+	answerLengthByPacketID.clear();
+}
+
+void WusbStack::expireIsoURBs( long long now ) {
+	if ( isoURBsInFlight.isEmpty() ) return;
+	QMutableHashIterator<unsigned int, long long> it( isoURBsInFlight );
+	while ( it.hasNext() ) {
+		it.next();
+		if ( it.value() <= now && now - it.value() <= WUSB_AZUREWAVE_ISO_ANSWER_TIMEOUT ) continue;
+		unsigned int packetID = it.key();
+		it.remove();
+		void * refData = packetRefDataByPacketID.take( packetID );
+		answerLengthByPacketID.remove( packetID );
+		// a late answer in reassembly must not be written to buffer of URB given back
+		messageBuffer->detachAnswerBuffers( packetID );
+		if ( urbReceiver && refData )
+			urbReceiver->giveBackAnswerURB( refData, false, NULL );
 	}
+}
 
+void WusbStack::cancelURB( void * refData ) {
+	if ( !refData ) return;
+	// URB not sent until now: just remove it from send queue
+	PendingURB_t canceledURB;
+	urbSendQueueMutex.lock();
+	bool found = urbScheduler->remove( refData, canceledURB );
+	urbSendQueueMutex.unlock();
+	if ( found ) {
+		delete canceledURB.urbData;
+		if ( urbReceiver )
+			urbReceiver->giveBackAnswerURB( refData, false, NULL );
+		return;
+	}
 
-	// Buffer to send (first packet == longest packet)
-	QByteArray buffer = QByteArray();
-	buffer.reserve( packetLen );
+	// URB sent to hub: hub cannot be stopped - but its answer is dropped and URB is not retransmitted
+	QMutableHashIterator<unsigned int, void*> it( packetRefDataByPacketID );
+	while ( it.hasNext() ) {
+		it.next();
+		if ( it.value() != refData ) continue;
+		unsigned int packetID = it.key();
+		it.remove();
+		answerLengthByPacketID.remove( packetID );
+		messageBuffer->detachAnswerBuffers( packetID );
+		releaseSendWindowSlot( packetID );
+		isoURBsInFlight.remove( packetID );
+		if ( urbReceiver )
+			urbReceiver->giveBackAnswerURB( refData, false, NULL );
+		flushSendQueue();
+		return;
+	}
+	// otherwise URB is answered already
+}
 
+void WusbStack::transmitCoalescedURBs() {
+	if ( coalesceBatch.isEmpty() ) return;
+	QList<PendingURB_t> urbs = coalesceBatch;
+	coalesceBatch.clear();
+	coalesceBatchLen = 0;
+	QList<InFlightURB_t> transactions;
+	QList<unsigned int> packetIDs;
+
+	if ( urbs.size() == 1 ) {
+		// nothing to pack: regular transmission
+		InFlightURB_t inFlight;
+		unsigned int packetID = transmitURB( urbs[0], &inFlight );
+		if ( packetID ) {
+			urbsInFlight.insert( packetID, inFlight );
+			return;
+		}
+		if ( urbReceiver && urbs[0].refData )
+			urbReceiver->giveBackAnswerURB( urbs[0].refData, false, NULL );
+		delete urbs[0].urbData;
+		return;
+	}
+
+	// XXX inferred: hub takes consecutive transactions (each with complete header and own TAN)
+	// from one datagram - like it concatenates its answers. Retransmissions are sent one by one.
+	int datagramLen = 0;
+	for ( int i = 0; i < urbs.size(); i++ )
+		datagramLen += WUSB_AZUREWAVE_SEND_HEADER_LEN + urbs[i].urbData->size();
+	if ( coalesceBuffer.size() < datagramLen )
+		coalesceBuffer.resize( datagramLen );	// buffer only grows
+	char * datagram = coalesceBuffer.data();
+	int idx = 0;
+	for ( int i = 0; i < urbs.size(); i++ ) {
+		int urbLen = urbs[i].urbData->size();
+		char * header = datagram + idx;
+		InFlightURB_t inFlight;
+		packetIDs.append( writeURBHeader( urbs[i], header, urbLen, 1 ) );
+		inFlight.firstSendTAN = currentSendTransactionNum;
+		inFlight.packetCount = 1;
+		inFlight.urbData = NULL;
+		if ( retransmitEnabled ) {
+			inFlight.urbData = urbs[i].urbData;
+			inFlight.headers = QByteArray( header, WUSB_AZUREWAVE_SEND_HEADER_LEN );
+		}
+		inFlight.firstPayloadLen = urbLen;
+		inFlight.subsqPayloadLen = sendMTU - WUSB_AZUREWAVE_SEND_SUBSQ_HEADER_LEN;
+		inFlight.ackedPackets = 0;
+		inFlight.retransmitCount = 0;
+		transactions.append( inFlight );
+		if ( urbLen > 0 )
+			::memcpy( header + WUSB_AZUREWAVE_SEND_HEADER_LEN, urbs[i].urbData->constData(), urbLen );
+		idx += WUSB_AZUREWAVE_SEND_HEADER_LEN + urbLen;
+	}
+	if ( logger->isDebugEnabled() )
+		logger->debug( QString("Send to hub: %1 URBs packed into one datagram (%2 bytes)").arg(
+				QString::number( urbs.size() ), QString::number( datagramLen ) ) );
+
+	bool res;
+	{
+		QMutexLocker locker( &sendBufferMutex );
+		res = dataChannel->queueDatagram( datagram, datagramLen );
+		if ( !res )
+			dataChannel->discardQueued();
+		else
+			res = dataChannel->flush();
+	}
+	lastPacketSendTimeMillis = currentTimeMillis();
+	if ( !res && dataChannel->lastSendTooBig() )
+		reduceSendMTU();
+	for ( int i = 0; i < urbs.size(); i++ ) {
+		if ( res ) {
+			transactions[i].sendTimeMillis = lastPacketSendTimeMillis;
+			transactions[i].lastTransmitMillis = lastPacketSendTimeMillis;
+			urbsInFlight.insert( packetIDs[i], transactions[i] );
+			if ( !retransmitEnabled )
+				delete urbs[i].urbData;
+			continue;
+		}
+		// URB could not be written to network: there will be no answer
+		packetRefDataByPacketID.remove( packetIDs[i] );
+		answerLengthByPacketID.remove( packetIDs[i] );
+		if ( urbReceiver && urbs[i].refData )
+			urbReceiver->giveBackAnswerURB( urbs[i].refData, false, NULL );
+		delete urbs[i].urbData;
+	}
+}
+
+unsigned int WusbStack::writeURBHeader( const PendingURB_t & urb, char * header, int urbLen, int numPackets ) {
 	currentSendTransactionNum = ( currentSendTransactionNum +1 ) % 256;
 	if ( sendPacketCounter == 0 )
 		currentTransactionNum = 0xff;
@@ -329,16 +1040,18 @@ bool WusbStack::sendURB (
 		currentTransactionNum = ( currentTransactionNum +1 ) % 256;
 //		currentTransactionNum = qMin(currentSendTransactionNum, currentReceiveTransactionNum);
 
-	WusbHelperLib::appendTransactionHeader( buffer, currentSendTransactionNum, currentReceiveTransactionNum, currentTransactionNum );
-	WusbHelperLib::appendMarker55Header( buffer, 0, intervalVal );	// XXX parameter1 unknown
-	unsigned int packetID = WusbHelperLib::appendPacketIDHeader( buffer );
+	WusbHelperLib::writeTransactionHeader( header, currentSendTransactionNum, currentReceiveTransactionNum, currentTransactionNum );
+	WusbHelperLib::writeMarker55Header( header + 4, 0, urb.intervalVal );	// XXX parameter1 unknown
+	unsigned int packetID = WusbHelperLib::writePacketIDHeader( header + 8 );
 
 	// storing the packetID of prepared (and hopefully sent) packet
-	if ( refData && dataTransferType != ISOCHRONOUS_TRANSFER )
-		packetRefDataByPacketID[packetID] = refData;
+	if ( urb.refData ) {
+		packetRefDataByPacketID[packetID] = urb.refData;
+		answerLengthByPacketID[packetID] = urb.receiveLength;
+	}
 
 	uint8_t xferDirectionValue = 0;
-	switch( dataTransferType ) {
+	switch( urb.dataTransferType ) {
 		case CONTROL_TRANSFER:
 			xferDirectionValue = 0x80;
 			break;
@@ -349,53 +1062,38 @@ bool WusbStack::sendURB (
 			xferDirectionValue = 0x40;
 			break;
 		case ISOCHRONOUS_TRANSFER:
-			// isochronous transfer is enabled by transfer flag (?)
+			// isochronous transfer is enabled by transfer flag (?) - packet table (if any) is part of payload
 			xferDirectionValue = 0;
 			break;
 	}
 	// TODO data direction, endpoint and special treatment of some transfer types
-//	if ( directionType == TI_WusbStack::DATADIRECTION_OUT || dataTransferType == CONTROL_TRANSFER )
-//		buffer.append( 0x80 >> endpoint );
-
-	buffer.append( xferDirectionValue );
+	header[12] = xferDirectionValue;
 
 	// Endpoint address
-	uint16_t endptShrt = (endpoint << 7);
-	buffer.append( (endptShrt & 0xff00) >> 8 );
-	buffer.append( endptShrt & 0xff );
+	uint16_t endptShrt = (urb.endpoint << 7);
+	header[13] = (endptShrt & 0xff00) >> 8;
+	header[14] = endptShrt & 0xff;
 
-	if ( directionType == TI_WusbStack::DATADIRECTION_IN )
-		buffer.append( 0x80 );
+	if ( urb.directionType == TI_WusbStack::DATADIRECTION_IN )
+		header[15] = 0x80;
 	else
-		buffer.append('\0' );
-	/*
-	// XXX WTF?
-	if ( directionType == TI_WusbStack::DATADIRECTION_IN && dataTransferType != CONTROL_TRANSFER )
-		buffer.append( 0x80 );
-	else
-		buffer.append( '\0' );
-	if ( directionType == TI_WusbStack::DATADIRECTION_IN )
-		buffer.append( 0x80 );
-	else
-		buffer.append('\0' );sendPacketCounter
-	*/
+		header[15] = '\0';
 
-	buffer.append( '\0' );
-	buffer.append( '\0' );
-	buffer.append( (transferFlags & 0xff00) >> 8 );
-	buffer.append( transferFlags & 0xff );
+	header[16] = '\0';
+	header[17] = '\0';
+	header[18] = (urb.transferFlags & 0xff00) >> 8;
+	header[19] = urb.transferFlags & 0xff;
 
-	WusbHelperLib::appendPacketLength( buffer, receiveLength );
-	WusbHelperLib::appendPacketLength( buffer, urbData->length() );
+	WusbHelperLib::writePacketLength( header + 20, urb.receiveLength );
+	WusbHelperLib::writePacketLength( header + 24, urbLen );
 
-	// The first (eventually the only) packet with URB
-	if ( messageSplit.isEmpty() )
-		buffer.append( *urbData );
-	else
-		buffer.append( messageSplit.first() );
+	// the transaction header carries current receive TAN: a pending ack is piggybacked on this URB
+	clearPendingAcknowledge();
 
 	if ( logger->isTraceEnabled() )
-		logger->trace( WusbHelperLib::messageToString( buffer, buffer.length() ) );
+		logger->trace( QString("%1 + %2 bytes URB").arg(
+				WusbHelperLib::messageToString( (const uint8_t*) header, WUSB_AZUREWAVE_SEND_HEADER_LEN ),
+				QString::number( qMin( urbLen, sendMTU - WUSB_AZUREWAVE_SEND_HEADER_LEN ) ) ) );
 
 	if ( sendPacketCounter == 0 )
 		currentTransactionNum = 0;
@@ -404,28 +1102,85 @@ bool WusbStack::sendURB (
 		logger->debug( QString("Send to hub: ID=%1 tan1=%2 tan2=%3 tan=%4 countMsg=%5").arg(
 				QString::number(packetID,16), QString::number(currentSendTransactionNum,16),
 				QString::number(currentReceiveTransactionNum,16), QString::number(currentTransactionNum,16),
-				messageSplit.isEmpty()? QString::number(1) : QString::number(messageSplit.size()) ) );
-	if ( messageSplit.isEmpty() ) {
-		delete urbData;
-		lastPacketSendTimeMillis = currentTimeMillis();
-		return writeToSocket( buffer );
-	} else {
-		QLinkedListIterator<QByteArray> it( messageSplit );
-		it.next();	// omit the first enty since that message is already processed.
-		bool res = writeToSocket( buffer );
+				QString::number( numPackets ) ) );
+	return packetID;
+}
+
+unsigned int WusbStack::transmitURB( const PendingURB_t & urb, InFlightURB_t * inFlight ) {
+	QByteArray * urbData = urb.urbData;
+	const char * payload = urbData->constData();
+	int urbLen = urbData->length();
+
+	// URBs bigger than MTU need to be split!
+	// only the first message part will be complete (with all header parts)
+	// subsequent message are composed of transaction header (with incremented send no.) and payload.
+	// Headers are written into a header pool - the payload is never copied but sent
+	// directly from URB buffer (scatter/gather I/O).
+	int firstPayloadLen = qMin( urbLen, sendMTU - WUSB_AZUREWAVE_SEND_HEADER_LEN );
+	int subsqPayloadLen = sendMTU - WUSB_AZUREWAVE_SEND_SUBSQ_HEADER_LEN;
+	int numSubsqPackets = 0;
+	if ( urbLen > firstPayloadLen )
+		numSubsqPackets = ( urbLen - firstPayloadLen + subsqPayloadLen - 1 ) / subsqPayloadLen;
+
+	int headerPoolLen = WUSB_AZUREWAVE_SEND_HEADER_LEN + numSubsqPackets * WUSB_AZUREWAVE_SEND_SUBSQ_HEADER_LEN;
+	if ( sendHeaderPool.size() < headerPoolLen )
+		sendHeaderPool.resize( headerPoolLen );	// pool only grows - allocation is done once for biggest URB
+	char * header = sendHeaderPool.data();
+
+	unsigned int packetID = writeURBHeader( urb, header, urbLen, numSubsqPackets + 1 );
+	int firstSendTAN = currentSendTransactionNum;
+
+	// All packets of URB are queued and written to network with one system call.
+	QMutexLocker locker( &sendBufferMutex );
+	// The first (eventually the only) packet with URB
+	// (queue is flushed implicitly if URB has more packets than one system call takes)
+	bool res = dataChannel->queueDatagram( header, WUSB_AZUREWAVE_SEND_HEADER_LEN, payload, firstPayloadLen );
+
+	if ( numSubsqPackets > 0 ) {
 		sendPacketCounter++;
-		lastPacketSendTimeMillis = currentTimeMillis();
-		while ( it.hasNext() ) {
-			buffer.clear();
+		int idx = firstPayloadLen;	// first position of next packet
+		char * subsqHeader = header + WUSB_AZUREWAVE_SEND_HEADER_LEN;
+		while ( res && idx < urbLen ) {
+			int len = qMin( subsqPayloadLen, urbLen - idx );
 			currentSendTransactionNum = (currentSendTransactionNum +1 ) % 256;
-			WusbHelperLib::appendTransactionHeader( buffer, currentSendTransactionNum, currentReceiveTransactionNum, currentTransactionNum );
-			buffer.append( it.next() );
-			res = writeToSocket( buffer );
-			lastPacketSendTimeMillis = currentTimeMillis();
+			WusbHelperLib::writeTransactionHeader( subsqHeader, currentSendTransactionNum, currentReceiveTransactionNum, currentTransactionNum );
+			res = dataChannel->queueDatagram( subsqHeader, WUSB_AZUREWAVE_SEND_SUBSQ_HEADER_LEN, payload + idx, len );
+			subsqHeader += WUSB_AZUREWAVE_SEND_SUBSQ_HEADER_LEN;
+			idx += len;
 		}
-		delete urbData;
-		return res;
 	}
+	// an implicit flush failed: URB is incomplete - rest of packets is not sent at all
+	if ( !res )
+		dataChannel->discardQueued();
+	else
+		res = dataChannel->flush();
+	lastPacketSendTimeMillis = currentTimeMillis();
+	if ( !res && dataChannel->lastSendTooBig() )
+		reduceSendMTU();
+	if ( !res ) {
+		packetRefDataByPacketID.remove( packetID );
+		answerLengthByPacketID.remove( packetID );
+		return 0;
+	}
+
+	if ( inFlight ) {
+		// everything needed to resend packets not acknowledged by hub
+		inFlight->sendTimeMillis = lastPacketSendTimeMillis;
+		inFlight->firstSendTAN = firstSendTAN;
+		inFlight->packetCount = numSubsqPackets + 1;
+		inFlight->urbData = NULL;
+		if ( retransmitEnabled ) {
+			inFlight->urbData = urbData;
+			inFlight->headers = QByteArray( header, headerPoolLen );
+		} else
+			delete urbData;
+		inFlight->firstPayloadLen = firstPayloadLen;
+		inFlight->subsqPayloadLen = subsqPayloadLen;
+		inFlight->ackedPackets = 0;
+		inFlight->lastTransmitMillis = lastPacketSendTimeMillis;
+		inFlight->retransmitCount = 0;
+	}
+	return packetID;
 }
 
 /*
@@ -436,8 +1191,6 @@ void WusbStack::processURB(
 		TI_WusbStack::eDataTransferType transferType, TI_WusbStack::eDataDirectionType dDirection,
 		QByteArray * urbData, uint8_t intervalVal, int expectedReceiveLength ) {
 
-	// the last packet
-	packetRefData = refData;
 	sendURB( refData, urbData, transferType, dDirection, endPointNo, transferFlags, intervalVal, expectedReceiveLength );
 }
 
@@ -445,6 +1198,62 @@ void WusbStack::registerURBreceiver( TI_USB_VHCI * urbSink ) {
 	urbReceiver = urbSink;
 }
 
+void WusbStack::attachURBChannel( URBChannel * channel ) {
+	urbChannelToAttach = channel;
+	// notifier of channel must be created/deleted by I/O thread
+	if ( QThread::currentThread() == receiverThread || !receiverThread->isRunning() )
+		attachURBChannelInternal();
+	else
+		QMetaObject::invokeMethod( this, "attachURBChannelInternal", Qt::BlockingQueuedConnection );
+}
+
+void WusbStack::attachURBChannelInternal() {
+	if ( urbChannel == urbChannelToAttach ) return;
+	if ( urbChannel ) {
+		if ( urbChannelNotifier ) {
+			urbChannelNotifier->setEnabled( false );
+			delete urbChannelNotifier;
+			urbChannelNotifier = NULL;
+		}
+		// URBs posted but not taken: there will be no answer
+		URBDescriptor_t request;
+		while ( urbChannel->takeRequest( request ) ) {
+			if ( request.cancelRequest ) {
+				cancelURB( request.refData );
+				continue;
+			}
+			if ( urbReceiver && request.refData )
+				urbReceiver->giveBackAnswerURB( request.refData, false, NULL );
+			delete request.urbData;
+		}
+	}
+	urbChannel = urbChannelToAttach;
+	if ( urbChannel ) {
+		urbChannelNotifier = new QSocketNotifier( urbChannel->getRequestEventFD(), QSocketNotifier::Read, this );
+		connect( urbChannelNotifier, SIGNAL(activated(int)), this, SLOT(processURBrequests()) );
+		// requests may be posted before notifier was created
+		processURBrequests();
+	}
+}
+
+void WusbStack::processURBrequests() {
+	if ( !urbChannel ) return;
+	urbChannel->clearRequestEvent();
+	URBDescriptor_t request;
+	// all URBs posted meanwhile are queued first - and scheduled together
+	takingURBrequests = true;
+	while ( urbChannel->takeRequest( request ) ) {
+		if ( request.cancelRequest )
+			cancelURB( request.refData );
+		else
+			processURB( request.refData, request.transferFlags, request.endpoint,
+					request.transferType, request.direction,
+					request.urbData, request.intervalVal, request.expectedReceiveLength );
+	}
+	takingURBrequests = false;
+	flushSendQueue();
+}
+
 void WusbStack::sendAcknowledgeReplyMessage() {
 	int tempSendTransactionNum = (currentSendTransactionNum +1 ) % 256;
 	int tempTransactionNum = 0;
@@ -454,6 +1263,7 @@ void WusbStack::sendAcknowledgeReplyMessage() {
 		tempTransactionNum = qMin(currentSendTransactionNum, currentReceiveTransactionNum);
 
 	lastPacketSendTimeMillis = currentTimeMillis();
+	clearPendingAcknowledge();
 	sendIdleMessage( tempSendTransactionNum, currentReceiveTransactionNum, tempTransactionNum );
 }
 
@@ -480,29 +1290,34 @@ void WusbStack::processStatusMessage( WusbMessageBuffer::eTypeOfMessage typeMsg,
 	case WusbMessageBuffer::DEVICE_OPEN_SUCCESS:
 		lastPacketReceiveTimeMillis = currentTimeMillis();
 		logger->info(QString("Status message: OPEN_SUCCESS") );
-		state = STATE_OPENED;
+		startConnectionTimers();
+		setState( STATE_OPENED );
+		// URBs kept from a suspended connection
+		flushSendQueue();
 		break;
 	case WusbMessageBuffer::DEVICE_CLOSE_SUCCESS:
 		lastPacketReceiveTimeMillis = currentTimeMillis();
 		logger->info(QString("Status message: CLOSE_SUCCESS") );
-		state = STATE_CLOSED;
+		setState( STATE_CLOSED );
 		break;
 	case WusbMessageBuffer::DEVICE_ALIVE:
 		lastPacketReceiveTimeMillis = currentTimeMillis();
 		if ( logger->isDebugEnabled() )
 			logger->debug(QString("Status message: DEVICE_ALIVE") );
+		// XXX inferred: second TAN of hub is the next TAN expected from us (see DUP handling below)
+		// - not verified with a capture, so acknowledges are used for round trip time only by default
+		// (see retransmitEnabled)
+		if ( tan1 || tan2 || tan3 )
+			acknowledgeSentPackets( tan2 );
 		break;
 	case WusbMessageBuffer::DEVICE_STALL:
 		lastPacketReceiveTimeMillis = currentTimeMillis();
 		// an error occured!
 		logger->warn(QString("Status message: DEVICE_STALL") );
 		// -> send error message to message receiver
-		state = STATE_FAILED;
-		if ( urbReceiver && packetRefData ) {
-			// Procedure for passing URB to OS integration module
-			urbReceiver->giveBackAnswerURB( packetRefData, false, NULL );
-			packetRefData = NULL;	// XXX this may be not true for isochronous transfer!
-		}
+		setState( STATE_FAILED );
+		// there will be no answer for any outstanding URB
+		failOutstandingURBs();
 		break;
 	case WusbMessageBuffer::DEVICE_RECEIVED_DUP:
 		lastPacketReceiveTimeMillis = currentTimeMillis();
@@ -517,29 +1332,40 @@ void WusbStack::processStatusMessage( WusbMessageBuffer::eTypeOfMessage typeMsg,
 /*
  * Receive URB from network (MessageBuffer).
  */
-void WusbStack::processURBmessage( unsigned int packetID, QByteArray * urbBytes ) {
+void WusbStack::processURBmessage( unsigned int packetID, const PooledBuffer & urbBuffer ) {
 	if ( logger->isTraceEnabled() )
 		logger->trace(QString("Received URB: %1").
-				arg( WusbHelperLib::messageToString( *urbBytes, urbBytes->length() ) ));
+				arg( WusbHelperLib::messageToString( (const uint8_t*) urbBuffer.data, urbBuffer.length ) ));
 
 	lastPacketReceiveTimeMillis = currentTimeMillis();
 
+	// answer received: transaction is completed and leaves send window
+	releaseSendWindowSlot( packetID );
+	isoURBsInFlight.remove( packetID );
+
 	if ( urbReceiver ) {
 		// Procedure for passing URB to OS integration module
 		if ( packetID && packetRefDataByPacketID.contains( packetID ) ) {
 			// packet lookup positiv -> use reference data from hash
-			urbReceiver->giveBackAnswerURB( packetRefDataByPacketID[ packetID ], true, urbBytes );
+			// (buffer is handed over as it is - it goes back to pool after completing URB)
+			urbReceiver->giveBackAnswerURB( packetRefDataByPacketID[ packetID ], true, urbBuffer );
 			packetRefDataByPacketID.remove( packetID );
+			answerLengthByPacketID.remove( packetID );
 		} else {
-			logger->warn(QString("Fallback of packet ref data (ID = 0x%1)").arg( QString::number( packetID, 16) ) );
-//			urbReceiver->giveBackAnswerURB( packetRefData, true, urbBytes );
-			packetRefData = NULL;	// XXX this may be not true for isochronous transfer!
+			// URB was canceled or already given back as failed
+			logger->warn(QString("No outstanding URB for answer (ID = 0x%1) - answer dropped").arg( QString::number( packetID, 16) ) );
+			PooledBuffer unusedBuffer = urbBuffer;
+			unusedBuffer.release();
 		}
 	} else {
 		// Procedure for passing URB to internal processing (more or less debug code)
-		emit receivedURB( *urbBytes );
-		delete urbBytes;
+		emit receivedURB( QByteArray( urbBuffer.data, urbBuffer.length ) );
+		PooledBuffer unusedBuffer = urbBuffer;
+		unusedBuffer.release();
 	}
+
+	// next URBs may be sent now
+	flushSendQueue();
 }
 
 void WusbStack::informReceivedPacket( int newReceiverTAN, int lastSessionTAN, unsigned int packetCounter ) {
@@ -549,6 +1375,16 @@ void WusbStack::informReceivedPacket( int newReceiverTAN, int lastSessionTAN, un
 	// XXX this is wrong in some cases (dup messages, retransmit etc.)
 	currentReceiveTransactionNum = newReceiverTAN;
 
+	// XXX inferred: receiver TAN of hub is the next TAN expected from us - it acknowledges our
+	// packets (not verified with a capture: used for round trip time only by default)
+	acknowledgeSentPackets( (uint8_t) newReceiverTAN );
+
+	// packet needs to be acknowledged - either by next URB sent or by an ack message after a short delay
+	scheduleAcknowledge();
+
+	// every packet from hub may advance the send window
+	flushSendQueue();
+
 }
 
 /* ************** Debug / printf methods ************** */
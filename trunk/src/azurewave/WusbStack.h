@@ -11,15 +11,20 @@
 
 #include "../TI_WusbStack.h"
 #include "WusbMessageBuffer.h"
+#include "WusbURBScheduler.h"
+#include "../utils/BufferPool.h"
 #include <QObject>
 #include <QHostAddress>
 #include <QLinkedList>
 #include <QQueue>
 #include <QHash>
 #include <QMutex>
-#include <QAbstractSocket>
+#include <QWaitCondition>
+#include <QByteArray>
 
-class QUdpSocket;
+class WusbDatagramChannel;
+class URBChannel;
+class QSocketNotifier;
 class QByteArray;
 class WusbReceiverThread;
 class WusbMessageBuffer;
@@ -34,14 +39,58 @@ class TI_USB_VHCI;
 #define WUSB_AZUREWAVE_SEND_SUBSQ_HEADER_LEN	4
 /** Header length of a received packet (answer packet from hub) */
 #define WUSB_AZUREWAVE_RECEIVE_HEADER_LEN		24
-/** Basic timer interval to check for retransmit or to send ack/idle/keep alive messages */
-#define WUSB_AZUREWAVE_TIMER_INTERVAL			50L
-/** maximum size of one network packet (protocol/device does not support bigger packets or fragments!) */
+/** Basic timer interval to check for keep alive messages and URBs without answer (acks are scheduled on receive) */
+#define WUSB_AZUREWAVE_TIMER_INTERVAL			250L
+/** default size of one network packet (all hubs support this size - hub sends packets of this size) */
 #define WUSB_AZUREWAVE_NETWORK_DEFAULT_MTU		1472
-/** after this time a ACK is send to hub when no further packets (URB) are ready to send  */
-#define WUSB_AZUREWAVE_TIMER_SEND_ACK			100L
+/** lower limit of (configurable) packet size */
+#define WUSB_AZUREWAVE_NETWORK_MIN_MTU			512
+/** upper limit of packet size (max. UDP payload) */
+#define WUSB_AZUREWAVE_NETWORK_MAX_MTU			65507
+/** number of retransmissions of a packet bigger than default MTU until the hub is assumed not to accept it */
+#define WUSB_AZUREWAVE_MTU_PROBE_RETRANSMIT		2
+/** default delay (ms) of an ACK after receiving a packet - ACKs of all packets received meanwhile are coalesced */
+#define WUSB_AZUREWAVE_DEFAULT_ACK_DELAY		2
+/** upper limit of (configurable) ACK delay */
+#define WUSB_AZUREWAVE_MAX_ACK_DELAY			100
 /** after this time of idle running a KEEP ALIVE message is send to hub */
 #define WUSB_AZUREWAVE_TIMER_SEND_KEEP_ALIVE	2000L
+/** default number of URB transactions sent to hub without having an answer (size of send window) */
+#define WUSB_AZUREWAVE_DEFAULT_SEND_WINDOW		8
+/** upper limit of send window (TAN is only one byte - a window must not wrap around) */
+#define WUSB_AZUREWAVE_MAX_SEND_WINDOW			64
+/** slots of send window not used by bulk URBs (control and interrupt URBs are never blocked by bulk transfers) */
+#define WUSB_AZUREWAVE_PRIORITY_WINDOW_SLOTS	1
+/** default number of bulk bytes sent (or requested) before other URBs are taken from URB channel */
+#define WUSB_AZUREWAVE_DEFAULT_BULK_BUDGET		65536
+/** max. length of an URB packed together with other small URBs into one datagram (see <tt>azurewave.wusb.coalesceSmallURBs</tt>) */
+#define WUSB_AZUREWAVE_COALESCE_MAX_URB_LEN		256
+/** number of unused MTU sized receive buffers kept for reuse */
+#define WUSB_AZUREWAVE_SMALL_URB_POOL_SIZE		64
+/** size of receive buffers for URBs bigger than MTU (bigger URBs are not pooled) */
+#define WUSB_AZUREWAVE_LARGE_URB_BLOCK_SIZE		65536
+/** max. length of an answer of an URB not (or no longer) outstanding - longer answers are dropped */
+#define WUSB_AZUREWAVE_MAX_UNKNOWN_ANSWER_LEN	WUSB_AZUREWAVE_LARGE_URB_BLOCK_SIZE
+/** number of unused big receive buffers kept for reuse */
+#define WUSB_AZUREWAVE_LARGE_URB_POOL_SIZE		16
+/** min. time (ms) an isochronous URB may wait for transmission (max. time is given by its frames) */
+#define WUSB_AZUREWAVE_ISO_MIN_DEADLINE			8
+/** max. time (ms) to wait for answer of an isochronous URB - it is given back without data afterwards */
+#define WUSB_AZUREWAVE_ISO_ANSWER_TIMEOUT		1000L
+/** an URB transaction not acknowledged by hub within this time is removed from send window */
+#define WUSB_AZUREWAVE_TIMER_URB_TIMEOUT		5000L
+/** retransmit timeout (ms) used until first round trip time is measured */
+#define WUSB_AZUREWAVE_INITIAL_RTO				200
+/** default lower limit of retransmit timeout (ms) */
+#define WUSB_AZUREWAVE_DEFAULT_MIN_RTO			20
+/** default upper limit of retransmit timeout (ms) */
+#define WUSB_AZUREWAVE_DEFAULT_MAX_RTO			2000
+/** max. number of retransmissions of one URB (URB timeout cleans up afterwards) */
+#define WUSB_AZUREWAVE_MAX_RETRANSMIT			6
+/** max. time (ms) to wait for answer of hub on open request */
+#define WUSB_AZUREWAVE_TIMER_OPEN_TIMEOUT		3000L
+/** max. time (ms) to wait for answer of hub on close request */
+#define WUSB_AZUREWAVE_TIMER_CLOSE_TIMEOUT		5000L
 
 class WusbStack : public TI_WusbStack {
 	Q_OBJECT
@@ -51,7 +100,8 @@ public:
 	virtual ~WusbStack();
 
 	/**
-	 * Open connection to device
+	 * Open connection to device. Network I/O is done in I/O thread of stack -
+	 * caller is blocked until device answered (or timeout).
 	 * @return <code>true</code> if no fatal errors (socket open, network error etc) occur.
 	 */
 	bool openConnection();
@@ -60,6 +110,11 @@ public:
 	 * @return <code>true</code> if no fatal errors occur and connection is active.
 	 */
 	bool closeConnection();
+	/**
+	 * Connection to hub is lost for a moment: drop network connection but keep URBs not sent
+	 * until now (see <tt>TI_WusbStack</tt>). Caller is blocked until I/O thread is done.
+	 */
+	bool suspendConnection();
 	/**
 	 * Send USB request block (<em>URB</em>) to device. The URB is wrapped with
 	 * headers and if necessary broken into smaller pieces for transport.<br>
@@ -101,25 +156,94 @@ public:
 	 */
 	virtual void registerURBreceiver( TI_USB_VHCI * urbSink );
 
+	/**
+	 * Attaches URB channel of virtual port (<tt>NULL</tt> detaches current channel).
+	 * @see TI_WusbStack
+	 */
+	virtual void attachURBChannel( URBChannel * channel );
+
 	/**
 	 * Returns reference to logger.
 	 */
 	Logger * getLogger();
 
+	/**
+	 * Returns a buffer for a received URB of given size (taken from receive buffer pool).
+	 * Buffer has to be released by receiver of URB.
+	 */
+	PooledBuffer allocateURBBuffer( int size );
+	/**
+	 * Returns a buffer for answer of outstanding URB <tt>packetID</tt>: the data buffer of host URB
+	 * if host interface offers it (answer is reassembled in place), a pooled buffer otherwise.
+	 */
+	PooledBuffer allocateAnswerBuffer( int size, unsigned int packetID );
+	/**
+	 * Max. length of answer of URB <tt>packetID</tt>: length expected by host (but at least one packet).
+	 * Length of answer is taken from network - a bigger answer is corrupt and must be dropped.
+	 */
+	int maxAnswerLength( unsigned int packetID ) const;
+
 
 private:
 	static bool isFirstInstance;
 
+	/** An URB waiting for a free slot in send window */
+	typedef WusbPendingURB_t PendingURB_t;
+	/** An URB transaction sent to hub and not answered yet */
+	struct InFlightURB_t {
+		/** Timestamp when URB was sent */
+		long long sendTimeMillis;
+		/** TAN of first network packet of URB */
+		int firstSendTAN;
+		/** Number of network packets used to transmit URB */
+		int packetCount;
+		/** URB data - kept for retransmission until all packets are acknowledged (<tt>NULL</tt> afterwards) */
+		QByteArray * urbData;
+		/** Headers of all packets as sent (first header followed by headers of continued packets) */
+		QByteArray headers;
+		/** Payload length of first packet */
+		int firstPayloadLen;
+		/** Max. payload length of continued packets */
+		int subsqPayloadLen;
+		/** Number of packets acknowledged by hub (packets are acknowledged in order) */
+		int ackedPackets;
+		/** Timestamp of last (re-)transmission */
+		long long lastTransmitMillis;
+		/** Number of retransmissions (no RTT sample is taken of retransmitted URBs) */
+		int retransmitCount;
+	};
+
 	eStackState state;
+	/** Guards state changes (state is awaited by threads opening/closing connection) */
+	QMutex stateMutex;
+	QWaitCondition stateChanged;
+	/** Flag: close request was sent to device (set by I/O thread) */
+	bool closeRequestSent;
 	QHostAddress destAddress;
 	int destPort;
-	QUdpSocket *udpSocket;
+	/** Datagram channel to hub (UDP) */
+	WusbDatagramChannel *dataChannel;
 	bool haveAnswer;
 	QLinkedList<QByteArray*> receiveBuffer;
 	QQueue<const QByteArray*> sendBuffer;
 	QMutex receiveBufferMutex;
 	QMutex sendBufferMutex;
+	/** Size of packets received from hub (hub splits answers into packets of this size) */
 	int maxMTU;
+	/** Size of packets sent to hub (configured or discovered) */
+	int sendMTU;
+	/** Configured size of packets sent to hub */
+	int configuredMTU;
+	/** Flag: path MTU discovery is enabled */
+	bool mtuDiscovery;
+	/** Flag: hub has acknowledged a packet of <tt>sendMTU</tt> size (or size is not bigger than default) */
+	bool sendMTUconfirmed;
+	/** Packet size known to work with this hub (persisted per hub, <tt>0</tt> if unknown) */
+	int hubMTU;
+	/** Flag: <tt>hubMTU</tt> was changed and needs to be persisted */
+	bool hubMTUchanged;
+	/** Config key of packet size of this hub */
+	QString hubMTUkey;
 	int currentSendTransactionNum;
 	int currentReceiveTransactionNum;
 	int currentTransactionNum;
@@ -132,46 +256,184 @@ private:
 	/** Timestamp: Last keep-alive packet sent */
 	long long lastSendAlivePacket;
 
+	/** I/O thread of stack: all network communication is processed with its event loop */
 	WusbReceiverThread *receiverThread;
 	WusbMessageBuffer *messageBuffer;
 
 	Logger * logger;	// ref to logger
 
 	QTimer * connectionKeeperTimer;
+	/** Single shot timer: deadline for acknowledge of received packets */
+	QTimer * ackTimer;
+	/** Delay (ms) of acknowledge message after receive */
+	int ackDelayMillis;
+	/** Flag: received packets are not acknowledged until now */
+	bool ackPending;
+	/**
+	 * Flag: acknowledges of hub are trusted - a received URB frees its slot of send window and
+	 * packets not acknowledged are retransmitted. Meaning of TAN acknowledged by hub is not verified
+	 * yet: by default acknowledges are used for round trip time only (slots are freed by answer or timeout).
+	 */
+	bool retransmitEnabled;
+	/** Single shot timer: earliest retransmit deadline of packets not acknowledged by hub */
+	QTimer * retransmitTimer;
+	/** Smoothed round trip time (ms) */
+	int srttMillis;
+	/** Round trip time variation (ms) */
+	int rttVarMillis;
+	/** Current retransmit timeout (ms) */
+	int rtoMillis;
+	/** Flag: at least one round trip time was measured */
+	bool haveRTTsample;
+	/** Limits of retransmit timeout (ms) */
+	int minRTOMillis;
+	int maxRTOMillis;
 
 	/** Receiver of URBs from network hub */
 	TI_USB_VHCI * urbReceiver;
-	/** Reference data for last data packet sent */
-	void * packetRefData;
+	/** Channel with URBs from host (virtual port) */
+	URBChannel * urbChannel;
+	/** Channel to be attached by I/O thread */
+	URBChannel * urbChannelToAttach;
+	/** Wakeup of I/O thread if URBs are posted to channel */
+	QSocketNotifier * urbChannelNotifier;
+	/** Reference data of all URBs sent and not answered (by packet ID) - any number of URBs may be outstanding */
 	QHash<unsigned int, void*> packetRefDataByPacketID;
+	/** Length of answer expected by host of all URBs of <tt>packetRefDataByPacketID</tt> (by packet ID) */
+	QHash<unsigned int, int> answerLengthByPacketID;
+
+	/** URBs waiting for transmission (send window is full) - queued per endpoint */
+	WusbURBScheduler * urbScheduler;
+	/** URBs may be queued by any thread - but are sent by I/O thread only */
+	QMutex urbSendQueueMutex;
+	/** Flag: bulk budget was used up - send queue is flushed again after pending events are processed */
+	bool flushSendQueuePosted;
+	/** Flag: URBs are taken from URB channel - send queue is flushed once after channel is drained */
+	bool takingURBrequests;
+	/** Flag: small interrupt and bulk URBs of one scheduling round are packed into one datagram */
+	bool coalesceSmallURBs;
+	/** Small URBs taken from send queue and not written until now (next datagram) */
+	QList<PendingURB_t> coalesceBatch;
+	/** Length of next datagram (headers and payload of all URBs of <tt>coalesceBatch</tt>) */
+	int coalesceBatchLen;
+	/** Datagram of packed URBs (buffer is reused) */
+	QByteArray coalesceBuffer;
+	/** URB transactions not acknowledged by hub (by packet ID) - each takes a slot of send window */
+	QHash<unsigned int, InFlightURB_t> urbsInFlight;
+	/**
+	 * URBs received by hub but not answered (send time by packet ID). They do not use send window:
+	 * IN URBs (e.g. interrupt endpoints) may wait for an answer for any time.
+	 */
+	QHash<unsigned int, long long> urbsAwaitingAnswer;
+	/** Number of URB transactions removed from send window without acknowledge of hub */
+	unsigned int urbsUnacknowledged;
+	/** Max. number of URB transactions in flight */
+	int sendWindowSize;
+	/** Isochronous URBs sent and not answered (send time by packet ID) - they do not use send window */
+	QHash<unsigned int, long long> isoURBsInFlight;
+	/** Number of isochronous URBs dropped because they were too late */
+	unsigned int isoURBsDropped;
+	/** Flag: isochronous URBs start with a packet table (see <tt>TI_WusbStack.h</tt>) */
+	bool isoPacketTable;
+	/** Receive buffers for URBs up to MTU size */
+	BufferPool * smallURBpool;
+	/** Receive buffers for URBs reassembled from many packets */
+	BufferPool * largeURBpool;
+	/** Pool of packet headers for one URB (28 bytes header plus 4 bytes for each continued packet) */
+	QByteArray sendHeaderPool;
 
 	bool openSocket();
 	bool writeToSocket( const QByteArray & buffer );
 	bool openDevice();
 	bool closeDevice();
 	const QString stateToString();
+	void startConnectionTimers();
 	void stopTimer();
+	/** Change state of stack and wake up threads waiting for state change */
+	void setState( eStackState newState );
+	/** Wait until stack is in <tt>wantedState</tt> (or failed). Must not be called by I/O thread. */
+	bool waitForState( eStackState wantedState, unsigned long timeoutMillis );
 
 	/** Send idle / keepalive message to device  */
 	bool sendIdleMessage( uint8_t sendTAN = 0, uint8_t recTAN = 0, uint8_t tan = 0 );
 	/** Send receive acknowledge message */
 	void sendAcknowledgeReplyMessage();
+	/** Arm acknowledge deadline (if not armed already) for a received packet */
+	void scheduleAcknowledge();
+	/** Received packets are acknowledged by a message just sent */
+	void clearPendingAcknowledge();
+	/**
+	 * Wrap URB with headers and write it to network. Returns the used packet ID (0 on error).
+	 * If <tt>inFlight</tt> is given it is filled with everything needed to retransmit URB.
+	 * URB data is not deleted.
+	 */
+	unsigned int transmitURB( const PendingURB_t & urb, InFlightURB_t * inFlight );
+	/**
+	 * Write header of first packet of an URB (next TAN and packet ID are taken).
+	 * @return	packet ID of URB
+	 */
+	unsigned int writeURBHeader( const PendingURB_t & urb, char * header, int urbLen, int numPackets );
+	/** Write all URBs of <tt>coalesceBatch</tt> (each with its own header) as one datagram */
+	void transmitCoalescedURBs();
+	/** Hub has received all our packets before <tt>nextExpectedTAN</tt> */
+	void acknowledgeSentPackets( uint8_t nextExpectedTAN );
+	/** Update round trip time estimation and retransmit timeout with a new sample */
+	void updateRetransmitTimeout( long long rttMillis );
+	/** Arm retransmit timer for earliest deadline of unacknowledged packets */
+	void scheduleRetransmit();
+	/** Resend all packets of URB not acknowledged by hub */
+	void retransmitPackets( InFlightURB_t & urb );
+	/** Determine packet size for new connection (in I/O thread) */
+	void initSendMTU();
+	/** Packet size in use is (not) accepted by hub - remember result for this hub */
+	void confirmSendMTU( bool accepted );
+	/** A packet was too big for network path: reduce packet size to path MTU */
+	void reduceSendMTU();
+	/** Hub has got all packets of URB: it leaves send window and awaits its answer only */
+	void completeSentURB( unsigned int packetID );
+	/** Forget URB transaction (answer received or URB canceled) */
+	void releaseSendWindowSlot( unsigned int packetID );
+	/** Drop URBs sent to hub (send window) - given back to URB receiver as failed */
+	void discardURBsInFlight();
+	/** Give back all URBs sent and not answered until now as failed */
+	void failOutstandingURBs();
+	/** Host is not interested in URB anymore: drop it and give it back as failed */
+	void cancelURB( void * refData );
+	/** Give back isochronous URBs without answer of hub */
+	void expireIsoURBs( long long now );
 private slots:
+	/** Send queued URBs as long as there are free slots in send window */
+	void flushSendQueue();
+	/** Open socket and send open request to device (in I/O thread) */
+	void openConnectionInternal();
+	/** Send close request to device (in I/O thread) */
+	void closeDeviceInternal();
+	/** Stop timers and close socket (in I/O thread) */
+	void closeSocket();
+	/** Drop all queued and unanswered URBs - given back to URB receiver as failed */
+	void discardPendingURBs();
+	/** Detach URB channel, drop URBs in flight and close socket (in I/O thread) */
+	void suspendConnectionInternal();
+	/** Replace URB channel by <tt>urbChannelToAttach</tt> (in I/O thread) */
+	void attachURBChannelInternal();
+	/** Send all URBs posted to URB channel */
+	void processURBrequests();
 	/** Receive routine to read data on UDP socket. Will be called upon signal from QT socket stack. */
 	void processPendingData();
-	/** Signal from socket that an uncorrectable (on socket layer) error occured */
-	void socketError(QAbstractSocket::SocketError socketError);
 	/** Status of connection changed or some special packet received */
 	void processStatusMessage( WusbMessageBuffer::eTypeOfMessage typeMsg, uint8_t, uint8_t, uint8_t );
 	/** Receive of a URB pacekt from network */
-	void processURBmessage( unsigned int packetID, QByteArray * urbBytes );
+	void processURBmessage( unsigned int packetID, const PooledBuffer & urbBuffer );
 	void informReceivedPacket( int newReceiverTAN, int lastSessionTAN, unsigned int packetCounter );
 	void timerInterrupt();
+	/** Acknowledge deadline expired: send ack if not already piggybacked on an URB */
+	void sendPendingAcknowledge();
+	/** Retransmit deadline expired: resend packets not acknowledged by hub */
+	void retransmitTimeout();
 	virtual void processURB( void * refData, uint16_t transferFlags, uint8_t endPointNo,
 			TI_WusbStack::eDataTransferType transferType, TI_WusbStack::eDataDirectionType dDirection,
 			QByteArray * urbData, uint8_t intervalVal, int expectedReceiveLength );
 signals:
-	void receivedUDPdata(const QByteArray &);
 	void receivedURB( const QByteArray &);
 };
 
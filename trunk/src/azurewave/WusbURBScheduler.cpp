@@ -0,0 +1,138 @@
+/*
+ * WusbURBScheduler.cpp
+ *
+ * @author:		Sebastian Kolbe-Nusser &lt;Sebastian DOT Kolbe AT gmail DOT com&gt;
+ * @version:	$Id$
+ * @created:	2011-05-02
+ */
+
+#include "WusbURBScheduler.h"
+#include <QByteArray>
+
+/* scheduling classes in order of priority */
+#define SCHED_CLASS_CONTROL			0
+#define SCHED_CLASS_INTERRUPT		1
+#define SCHED_CLASS_ISOCHRONOUS		2
+#define SCHED_CLASS_BULK			3
+
+WusbURBScheduler::WusbURBScheduler( int budget ) {
+	bulkBudget = budget > 0? budget : 1;
+	bulkBytesLeft = bulkBudget;
+	numQueued = 0;
+	for ( int i = 0; i < WUSB_SCHEDULER_NUM_CLASSES; i++ )
+		nextQueue[i] = 0;
+}
+
+WusbURBScheduler::~WusbURBScheduler() {
+	// URBs still queued are owned by caller (see takeAll())
+}
+
+int WusbURBScheduler::schedulingClass( TI_WusbStack::eDataTransferType transferType ) {
+	switch ( transferType ) {
+	case TI_WusbStack::CONTROL_TRANSFER:
+		return SCHED_CLASS_CONTROL;
+	case TI_WusbStack::INTERRUPT_TRANSFER:
+		return SCHED_CLASS_INTERRUPT;
+	case TI_WusbStack::ISOCHRONOUS_TRANSFER:
+		return SCHED_CLASS_ISOCHRONOUS;
+	case TI_WusbStack::BULK_TRANSFER:
+	default:
+		return SCHED_CLASS_BULK;
+	}
+}
+
+void WusbURBScheduler::enqueue( const WusbPendingURB_t & urb ) {
+	int schedClass = schedulingClass( urb.dataTransferType );
+	QList<EndpointQueue_t> & classQueues = queues[ schedClass ];
+	// control endpoints are bidirectional: a SET request and a following GET must not be reordered
+	int key = urb.endpoint & 0x7f;
+	if ( schedClass != SCHED_CLASS_CONTROL && urb.directionType == TI_WusbStack::DATADIRECTION_IN )
+		key |= 0x80;
+	numQueued++;
+	// URBs of one endpoint keep their order
+	for ( int i = 0; i < classQueues.size(); i++ ) {
+		if ( classQueues[i].endpointKey == key ) {
+			classQueues[i].urbs.enqueue( urb );
+			return;
+		}
+	}
+	EndpointQueue_t queue;
+	queue.endpointKey = key;
+	queue.urbs.enqueue( urb );
+	classQueues.append( queue );
+}
+
+bool WusbURBScheduler::dequeue( WusbPendingURB_t & urb, bool windowFree, bool bulkWindowFree ) {
+	if ( numQueued == 0 ) return false;
+	if ( windowFree && takeNext( SCHED_CLASS_CONTROL, urb ) ) return true;
+	if ( windowFree && takeNext( SCHED_CLASS_INTERRUPT, urb ) ) return true;
+	if ( takeNext( SCHED_CLASS_ISOCHRONOUS, urb ) ) return true;
+	if ( windowFree && bulkWindowFree && bulkBytesLeft > 0 && takeNext( SCHED_CLASS_BULK, urb ) ) {
+		int length = qMax( urb.urbData? urb.urbData->size() : 0, urb.receiveLength );
+		bulkBytesLeft -= qMax( length, 1 );
+		return true;
+	}
+	return false;
+}
+
+bool WusbURBScheduler::takeNext( int schedClass, WusbPendingURB_t & urb ) {
+	QList<EndpointQueue_t> & classQueues = queues[ schedClass ];
+	if ( classQueues.isEmpty() ) return false;
+	int idx = nextQueue[ schedClass ] % classQueues.size();
+	urb = classQueues[idx].urbs.dequeue();
+	numQueued--;
+	if ( classQueues[idx].urbs.isEmpty() )
+		classQueues.removeAt( idx );	// next endpoint moves to this position
+	else
+		idx++;
+	nextQueue[ schedClass ] = classQueues.isEmpty()? 0 : idx % classQueues.size();
+	return true;
+}
+
+bool WusbURBScheduler::remove( void * refData, WusbPendingURB_t & urb ) {
+	for ( int c = 0; c < WUSB_SCHEDULER_NUM_CLASSES; c++ ) {
+		for ( int i = 0; i < queues[c].size(); i++ ) {
+			QQueue<WusbPendingURB_t> & urbs = queues[c][i].urbs;
+			for ( int j = 0; j < urbs.size(); j++ ) {
+				if ( urbs[j].refData != refData ) continue;
+				urb = urbs.takeAt( j );
+				numQueued--;
+				if ( urbs.isEmpty() ) {
+					queues[c].removeAt( i );
+					if ( nextQueue[c] > i ) nextQueue[c]--;
+				}
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+QList<WusbPendingURB_t> WusbURBScheduler::takeAll() {
+	QList<WusbPendingURB_t> urbs;
+	for ( int c = 0; c < WUSB_SCHEDULER_NUM_CLASSES; c++ ) {
+		for ( int i = 0; i < queues[c].size(); i++ )
+			while ( !queues[c][i].urbs.isEmpty() )
+				urbs.append( queues[c][i].urbs.dequeue() );
+		queues[c].clear();
+		nextQueue[c] = 0;
+	}
+	numQueued = 0;
+	return urbs;
+}
+
+void WusbURBScheduler::startRound() {
+	bulkBytesLeft = bulkBudget;
+}
+
+bool WusbURBScheduler::isBulkBudgetExhausted() const {
+	return bulkBytesLeft <= 0 && !queues[ SCHED_CLASS_BULK ].isEmpty();
+}
+
+int WusbURBScheduler::size() const {
+	return numQueued;
+}
+
+bool WusbURBScheduler::isEmpty() const {
+	return numQueued == 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * WusbURBScheduler.h
+ * Send queue of WUSB stack: URBs are queued per endpoint and taken by priority of
+ * transfer type (control, interrupt, isochronous, bulk). Endpoints of same transfer type
+ * are served round robin; bulk URBs are limited by a byte budget per scheduling round.
+ *
+ * @author:		Sebastian Kolbe-Nusser &lt;Sebastian DOT Kolbe AT gmail DOT com&gt;
+ * @version:	$Id$
+ * @created:	2011-05-02
+ */
+
+#ifndef WUSBURBSCHEDULER_H_
+#define WUSBURBSCHEDULER_H_
+
+#include "../TI_WusbStack.h"
+#include <QList>
+#include <QQueue>
+#include <stdint.h>
+
+class QByteArray;
+
+/** An URB waiting for transmission to hub */
+struct WusbPendingURB_t {
+	void * refData;
+	QByteArray * urbData;
+	TI_WusbStack::eDataTransferType dataTransferType;
+	TI_WusbStack::eDataDirectionType directionType;
+	uint8_t endpoint;
+	uint16_t transferFlags;
+	uint8_t intervalVal;
+	int receiveLength;
+	/** Isochronous URB: latest time to send URB (later frames are dropped) - <tt>0</tt> otherwise */
+	long long deadlineMillis;
+};
+
+/** Number of scheduling classes (one per transfer type) */
+#define WUSB_SCHEDULER_NUM_CLASSES		4
+
+class WusbURBScheduler {
+public:
+	/**
+	 * @param	bulkBudget	max. number of bulk bytes (sent or requested) per scheduling round
+	 */
+	WusbURBScheduler( int bulkBudget );
+	virtual ~WusbURBScheduler();
+
+	/** Append URB to queue of its endpoint */
+	void enqueue( const WusbPendingURB_t & urb );
+	/**
+	 * Takes next URB to send: control before interrupt before isochronous before bulk.
+	 * @param	windowFree		a slot in send window is free (isochronous URBs do not need a slot)
+	 * @param	bulkWindowFree	a slot in send window may be used by a bulk URB
+	 * @return	<code>false</code> if no URB may be sent now
+	 */
+	bool dequeue( WusbPendingURB_t & urb, bool windowFree, bool bulkWindowFree );
+	/** Removes queued URB with given reference data. @return <code>false</code> if not found */
+	bool remove( void * refData, WusbPendingURB_t & urb );
+	/** Removes and returns all queued URBs */
+	QList<WusbPendingURB_t> takeAll();
+
+	/** Starts a new scheduling round (bulk budget is refilled) */
+	void startRound();
+	/** Bulk URBs are waiting but budget of current round is used up */
+	bool isBulkBudgetExhausted() const;
+	/** Number of queued URBs */
+	int size() const;
+	bool isEmpty() const;
+
+private:
+	/** Queue of one endpoint */
+	struct EndpointQueue_t {
+		/** Endpoint number plus direction bit (0x80 for IN - not set for control endpoints) */
+		int endpointKey;
+		QQueue<WusbPendingURB_t> urbs;
+	};
+
+	/** Endpoints with queued URBs per scheduling class (empty queues are removed) */
+	QList<EndpointQueue_t> queues[WUSB_SCHEDULER_NUM_CLASSES];
+	/** Round robin position per scheduling class */
+	int nextQueue[WUSB_SCHEDULER_NUM_CLASSES];
+	int numQueued;
+	int bulkBudget;
+	int bulkBytesLeft;
+
+	static int schedulingClass( TI_WusbStack::eDataTransferType transferType );
+	/** Takes first URB of next endpoint (round robin) of scheduling class */
+	bool takeNext( int schedClass, WusbPendingURB_t & urb );
+};
+
+#endif /* WUSBURBSCHEDULER_H_ */
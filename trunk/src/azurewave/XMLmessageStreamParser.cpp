@@ -0,0 +1,696 @@
+/*
+ * XMLmessageStreamParser.cpp
+ *
+ * @author:		Sebastian Kolbe-Nusser &lt;Sebastian DOT Kolbe AT gmail DOT com&gt;
+ * @version:	$Id$
+ * @created:	2011-05-10
+ */
+
+#include "XMLmessageStreamParser.h"
+#include "HubDevice.h"
+#include "../ConfigManager.h"
+#include "../utils/Logger.h"
+#include "../BasicUtils.h"
+#include <QStringList>
+
+XMLmessageStreamParser::XMLmessageStreamParser( const QByteArray & message )
+: reader( message ) {
+	errorString = QString::null;
+	reportedPorts = 0;
+	logger = Logger::getLogger("XML");
+}
+
+XMLmessageStreamParser::~XMLmessageStreamParser() {
+}
+
+
+
+ControlMsg_DiscoveryResponse* XMLmessageStreamParser::parseDiscoveryMessage( const QByteArray & message ) {
+	/*
+	 <discoverResponse>
+		<name>MedionHUB</name>
+		<hwID type="hex">000000000000</hwID>
+		<pid type="int">4000</pid>
+		<vid type="int">2</vid>
+	</discoverResponse>
+
+	NOTE: since firmware version 1.17 the field "hwID" is filled with MAC address of device
+	*/
+
+	XMLmessageStreamParser parser( message );
+	ControlMsg_DiscoveryResponse * resultSet = parser.processDiscoveryMessage();
+	parser.logError();
+	return resultSet;
+}
+
+ControlMsg_DiscoveryResponse* XMLmessageStreamParser::processDiscoveryMessage() {
+	if ( !openRootElement("discoverResponse") ) {
+		if ( errorString.isNull() )
+			errorString = tr("XML message is not of type \"discoverResponse\"!");
+		return NULL;
+	}
+
+	ControlMsg_DiscoveryResponse * resultSet = new ControlMsg_DiscoveryResponse();
+	bool hasName = false, hasHwID = false, hasPid = false, hasVid = false;
+	while ( nextChildElement() ) {
+		if ( isElement("name") ) {
+			resultSet->name = elementText();
+			hasName = true;
+		} else if ( isElement("hwID") ) {
+			resultSet->hwid = elementText();
+			hasHwID = true;
+		} else if ( isElement("pid") ) {
+			resultSet->pid = elementIntValue( "int", 0 );
+			hasPid = true;
+		} else if ( isElement("vid") ) {
+			resultSet->vid = elementIntValue( "int", 0 );
+			hasVid = true;
+		} else
+			skipElement();
+	}
+
+	if ( !checkReaderError() ) {
+		if ( !hasName )
+			errorString = tr("XML message does not contain \"name\" element!");
+		else if ( !hasHwID )
+			errorString = tr("XML message does not contain \"hwID\" element!");
+		else if ( !hasPid )
+			errorString = tr("XML message does not contain \"pid\" element!");
+		else if ( !hasVid )
+			errorString = tr("XML message does not contain \"vid\" element!");
+	}
+	if ( !errorString.isNull() ) {
+		delete resultSet;
+		return NULL;
+	}
+	return resultSet;
+}
+
+QList<ControlMsg_DeviceDelta> XMLmessageStreamParser::parseServerInfoMessage( const QByteArray & message, HubDevice * refHubDevice ) {
+	/*
+	<getServerInfoResponse>
+		<protocol>WUSB 1.0</protocol>
+		<manufacturer>MEDION</manufacturer>
+		<modelName>MD-86097</modelName>
+		<deviceName>MedionHUB</deviceName>
+		<version>1.0.13</version>
+		<date>Thu Feb 25 18:18:44 CST 2010</date>
+		<usbDeviceList>
+			<device>
+				<port type="int">5</port>
+				<deviceID type="hex">DDCCBBAA</deviceID>
+				<status>pluged</status>
+				<bcdUSB type="hex">0110</bcdUSB>
+				<bClass type="hex">00</bClass>
+				<bSubClass type="hex">00</bSubClass>
+				<bProtocol type="hex">00</bProtocol>
+				<interface>
+					<bInterfaceNumber type="int">0</bInterfaceNumber>
+					<bClass type="hex">01</bClass>
+					<bSubClass type="hex">01</bSubClass>
+					<bProtocol type="hex">00</bProtocol>
+					<bNumEndpoints type="int">0</bNumEndpoints>
+				</interface>
+				<idVendor type="hex">13D3</idVendor>
+				<idProduct type="hex">3278</idProduct>
+				<bcdDevice type="hex">0100</bcdDevice>
+				<manufacturer>Manufacturer</manufacturer>
+				<product>Remote Audio</product>
+			</device>
+		</usbDeviceList>
+	</getServerInfoResponse>
+	*/
+	XMLmessageStreamParser parser( message );
+	parser.processServerInfoMessage( refHubDevice );
+	parser.logError();
+	return parser.deltas;
+}
+
+
+/**
+ * Parses all elements of a <em>ServerInfo</em> message and puts processed values into
+ * a <tt>HubDevice</tt>.
+ * @param	refHubDevice	Reference to <tt>HubDevice</tt>
+ * @return	<code>true</code> if parsing was successfull, otherwise <code>false</code>
+ */
+bool XMLmessageStreamParser::processServerInfoMessage( HubDevice * refHubDevice ) {
+	if ( !openRootElement("getServerInfoResponse") ) {
+		if ( errorString.isNull() )
+			errorString = tr("ServerInfo XML message is not of type \"getServerInfoResponse\"!");
+		return false;
+	}
+	bool hasProtocol = false, hasManufacturer = false, hasModelName = false;
+	bool hasDeviceName = false, hasVersion = false, hasDate = false;
+	bool hasDeviceList = false;
+	while ( nextChildElement() ) {
+		if ( isElement("protocol") ) {
+			refHubDevice->protocol = elementText();
+			hasProtocol = true;
+		} else if ( isElement("manufacturer") ) {
+			refHubDevice->manufacturer = elementText();
+			hasManufacturer = true;
+		} else if ( isElement("modelName") ) {
+			refHubDevice->modelName = elementText();
+			hasModelName = true;
+		} else if ( isElement("deviceName") ) {
+			refHubDevice->deviceName = elementText();
+			hasDeviceName = true;
+		} else if ( isElement("version") ) {
+			refHubDevice->firmwareVersion = elementText();
+			hasVersion = true;
+		} else if ( isElement("date") ) {
+			refHubDevice->firmwareDate = elementText();
+			hasDate = true;
+		} else if ( isElement("usbDeviceList") ) {
+			processServerInfoDeviceList( refHubDevice );
+			hasDeviceList = true;
+		} else
+			skipElement();
+	}
+
+	if ( !checkReaderError() ) {
+		if ( !hasProtocol )
+			errorString = tr("ServerInfo XML message does not contain \"protocol\" element!");
+		else if ( !hasManufacturer )
+			errorString = tr("ServerInfo XML message does not contain \"manufacturer\" element!");
+		else if ( !hasModelName )
+			errorString = tr("ServerInfo XML message does not contain \"modelName\" element!");
+		else if ( !hasDeviceName )
+			errorString = tr("ServerInfo XML message does not contain \"deviceName\" element!");
+		else if ( !hasVersion )
+			errorString = tr("ServerInfo XML message does not contain \"version\" element!");
+		else if ( !hasDate )
+			errorString = tr("ServerInfo XML message does not contain \"date\" element!");
+	}
+	if ( reader.hasError() || !hasDeviceList ) return false;
+
+	// devices not reported anymore are gone
+	for ( int port = 0; port < refHubDevice->deviceList.size(); port++ ) {
+		USBTechDevice * USBdev = refHubDevice->deviceList[port];
+		if ( ( reportedPorts & ( 1 << port ) ) || !USBdev->isValid ) continue;
+		USBdev->isValid = false;
+		USBdev->owned = false;
+		appendDeviceDelta( ControlMsg_DeviceDelta::DD_REMOVED, USBdev->deviceID, USBdev );
+	}
+	return errorString.isNull();
+}
+
+void XMLmessageStreamParser::processServerInfoDeviceList( HubDevice * refHubDevice ) {
+	while ( nextChildElement() ) {
+		if ( isElement("device") )
+			processServerInfoDeviceSection( refHubDevice );
+		else
+			skipElement();
+	}
+}
+
+void XMLmessageStreamParser::processServerInfoDeviceSection( HubDevice * refHubDevice ) {
+	// values are collected first: port (= device slot of hub) need not be first element of section
+	int port = -1;
+	int usageHint = -1;
+	int bClass = -1, bSubClass = -1, bProtocol = -1;
+	int idVendor = -1, idProduct = -1;
+	QString product, manufacturer, deviceID, statusText, hostName, hostIP, bcdUSB, bcdDevice;
+	QList<USBTechInterface> interfaces;
+
+	while ( nextChildElement() ) {
+		if ( isElement("port") )
+			port = elementIntValue( "int", 0 );
+		else if ( isElement("use_isoc") )
+			// Special feature since firmware 1.0.21(?): give client software a hint about usage of device
+			usageHint = elementIntValue( "int", 0 );
+		else if ( isElement("product") )
+			product = elementText();
+		else if ( isElement("manufacturer") )
+			manufacturer = elementText();
+		else if ( isElement("deviceID") )
+			deviceID = elementText();
+		else if ( isElement("status") )
+			statusText = elementText();
+		else if ( isElement("hostName") )
+			hostName = elementText();
+		else if ( isElement("hostIP") )
+			hostIP = elementText();
+		else if ( isElement("bClass") )
+			bClass = elementIntValue( "hex", 0 );
+		else if ( isElement("bSubClass") )
+			bSubClass = elementIntValue( "hex", 0 );
+		else if ( isElement("bProtocol") )
+			bProtocol = elementIntValue( "hex", 0 );
+		else if ( isElement("bcdUSB") )
+			bcdUSB = elementText();
+		else if ( isElement("bcdDevice") )
+			bcdDevice = elementText();
+		else if ( isElement("idVendor") )
+			idVendor = elementIntValue( "hex", 0 );
+		else if ( isElement("idProduct") )
+			idProduct = elementIntValue( "hex", 0 );
+		else if ( isElement("interface") ) {
+			// parse all interface structures of a device
+			USBTechInterface usbInterface;
+			if ( processDeviceInterfaceElement( usbInterface ) )
+				interfaces.append( usbInterface );
+		} else
+			skipElement();
+	}
+
+	if ( port < 0 ) {
+		errorString = tr("ServerInfo XML message: device section without \"port\" tag!");
+		return;
+	}
+	if ( port > 9 ) return;	// ??? should not occur???
+
+	USBTechDevice * USBdev = refHubDevice->deviceList[port];
+	DeviceState_t before = deviceState( USBdev );
+	reportedPorts |= 1 << port;
+	USBdev->isValid = true;
+	USBdev->portNum = port;
+
+	if ( usageHint >= 0 )
+		USBdev->usageHint = usageHint;
+	if ( !product.isNull() )
+		USBdev->product = product;
+	if ( !manufacturer.isNull() )
+		USBdev->manufacturer = manufacturer;
+	if ( !deviceID.isNull() )
+		USBdev->deviceID = deviceID;
+
+	USBdev->status = (USBTechDevice::ePlugStatus) interpretPlugStatus( statusText );
+
+	// if device is claimed by any host there is an extra tag with hostname / IP
+	if ( USBdev->status == USBTechDevice::PS_Claimed ) {
+		USBdev->claimedByName = hostName.isNull()? QString("unknownHost") : hostName;
+		USBdev->claimedByIP = hostIP.isNull()? USBdev->claimedByName : flipIPaddress( hostIP );
+
+		QString localhostname = ConfigManager::getInstance().getStringValue("hostname");
+		if ( !localhostname.isNull() && localhostname.compare( USBdev->claimedByName, Qt::CaseInsensitive ) == 0 )
+			USBdev->owned = true;
+		else
+			USBdev->owned = false;
+	} else if ( USBdev->status == USBTechDevice::PS_Unplugged || USBdev->status == USBTechDevice::PS_NotAvailable )
+		USBdev->isValid = false;
+
+	if ( bClass >= 0 )
+		USBdev->bClass = bClass;
+	if ( bSubClass >= 0 )
+		USBdev->bSubClass = bSubClass;
+	if ( bProtocol >= 0 )
+		USBdev->bProtocol = bProtocol;
+	if ( !bcdUSB.isNull() ) {
+		USBdev->bcdUSB = bcdUSB;
+		USBdev->sbcdUSB = unmarshallBCDversionValue( USBdev->bcdUSB, "1.0" );
+	}
+	if ( !bcdDevice.isNull() ) {
+		USBdev->bcdDevice = bcdDevice;
+		USBdev->sbcdDevice = unmarshallBCDversionValue( USBdev->bcdDevice, "0.0" );
+	}
+	if ( idVendor >= 0 )
+		USBdev->idVendor = idVendor;
+	if ( idProduct >= 0 )
+		USBdev->idProduct = idProduct;
+
+	QListIterator<USBTechInterface> it( interfaces );
+	while ( it.hasNext() ) {
+		const USBTechInterface & usbInterface = it.next();
+		// asure that list of interface definitions is large enough
+		while ( USBdev->interfaceList.size() <= usbInterface.if_number )
+			USBdev->interfaceList.append( USBTechInterface() );
+		USBdev->interfaceList[usbInterface.if_number] = usbInterface;
+	}
+	appendDeviceDelta( USBdev, before );
+}
+
+/**
+ * Reads an <tt>interface</tt> element of a device section.
+ * @return	<code>false</code> if interface number is missing or out of range
+ */
+bool XMLmessageStreamParser::processDeviceInterfaceElement( USBTechInterface & refInterface ) {
+	int interfaceNum = -1;
+	refInterface.if_class = 0;
+	refInterface.if_subClass = 0;
+	refInterface.if_protocol = 0;
+	refInterface.if_numEndpoints = 0;
+
+	while ( nextChildElement() ) {
+		if ( isElement("bInterfaceNumber") )
+			interfaceNum = elementIntValue( "int", -1 );
+		else if ( isElement("bClass") )
+			refInterface.if_class = elementIntValue( "hex", 0 );
+		else if ( isElement("bSubClass") )
+			refInterface.if_subClass = elementIntValue( "hex", 0 );
+		else if ( isElement("bProtocol") )
+			refInterface.if_protocol = elementIntValue( "hex", 0 );
+		else if ( isElement("bNumEndpoints") )
+			refInterface.if_numEndpoints = elementIntValue( "int", 0 );
+		else
+			skipElement();	// XXX endpoints definition?
+	}
+
+	if ( interfaceNum < 0 || interfaceNum > 255 ) {
+		errorString = tr("ServerInfo XML message: interface section without \"interfaceNumber\" tag!");
+		return false;
+	}
+	refInterface.isValid = true;
+	refInterface.if_number = interfaceNum;
+	return true;
+}
+
+
+QList<ControlMsg_DeviceDelta> XMLmessageStreamParser::parseStatusChangedMessage( const QByteArray & message, HubDevice * refHubDevice ) {
+	/*
+	<devStatusChanged>
+		<device>
+			<id type="hex">DDCCBBAA</id>
+			<status>imported</status>
+			<hostName>Notbuch</hostName>
+		</device>
+	</devStatusChanged>
+	*/
+	XMLmessageStreamParser parser( message );
+	parser.processStatusChangedMessage( refHubDevice );
+	parser.logError();
+	return parser.deltas;
+}
+
+void XMLmessageStreamParser::processStatusChangedMessage( HubDevice * refHubDevice ) {
+	if ( !openRootElement("devStatusChanged") ) {
+		if ( errorString.isNull() )
+			errorString = tr("StatusChanged XML message is not of type \"devStatusChanged\"!");
+		return;
+	}
+	// getting all related devices
+	while ( nextChildElement() ) {
+		if ( !isElement("device") ) {
+			skipElement();
+			continue;
+		}
+		QString sId, statusText, hostName;
+		while ( nextChildElement() ) {
+			if ( isElement("id") )
+				sId = elementText();
+			else if ( isElement("status") )
+				statusText = elementText();
+			else if ( isElement("hostName") )
+				hostName = elementText();
+			else
+				skipElement();
+		}
+		if ( sId.isEmpty() ) continue;
+
+		// finding the correct device
+		USBTechDevice * hUSBDev = refHubDevice->findDeviceByID( sId );
+		if ( !hUSBDev ) {
+			appendDeviceDelta( ControlMsg_DeviceDelta::DD_UNKNOWN_DEVICE, sId, NULL );
+			continue;
+		}
+		DeviceState_t before = deviceState( hUSBDev );
+
+		hUSBDev->status = (USBTechDevice::ePlugStatus) interpretPlugStatus( statusText );
+		if ( hUSBDev->status == USBTechDevice::PS_Claimed ) {
+			if ( !hostName.isNull() ) {
+				hUSBDev->claimedByName = hostName;
+				QString localhostname = ConfigManager::getInstance().getStringValue("hostname");
+				if ( !localhostname.isNull() && localhostname.compare( hUSBDev->claimedByName, Qt::CaseInsensitive ) == 0 )
+					hUSBDev->owned = true;
+				else
+					hUSBDev->owned = false;
+			}
+		} else if ( hUSBDev->status == USBTechDevice::PS_Unplugged || hUSBDev->status == USBTechDevice::PS_NotAvailable ) {
+			hUSBDev->isValid = false;
+			hUSBDev->owned = false;
+		} else {
+			hUSBDev->owned = false;
+		}
+		appendDeviceDelta( hUSBDev, before );
+	}
+	checkReaderError();
+}
+
+USBTechDevice * XMLmessageStreamParser::parseImportResponseMessage( const QByteArray & message, HubDevice * refHubDevice ) {
+	/*
+		<importResponse>
+			<errorCode type="int">0</errorCode>
+			<deviceID type="hex">0064BA81</deviceID>
+			<port type="int">8006</port>
+		</importResponse>
+	*/
+	XMLmessageStreamParser parser( message );
+	USBTechDevice * device = parser.processImportResponseMessage( refHubDevice );
+	parser.logError();
+	return device;
+}
+
+USBTechDevice * XMLmessageStreamParser::processImportResponseMessage( HubDevice * refHubDevice ) {
+	if ( !openRootElement("importResponse") ) {
+		if ( errorString.isNull() )
+			errorString = tr("ImportResponse XML message is not of type \"importResponse\"!");
+		return NULL;
+	}
+	QString deviceID;
+	int errorCode = 0, port = 0;
+	bool hasErrorCode = false, hasPort = false;
+	while ( nextChildElement() ) {
+		if ( isElement("deviceID") )
+			deviceID = elementText();
+		else if ( isElement("errorCode") ) {
+			errorCode = elementIntValue( "int", 0 );
+			hasErrorCode = true;
+		} else if ( isElement("port") ) {
+			port = elementIntValue( "int", 0 );
+			hasPort = true;
+		} else
+			skipElement();
+	}
+	if ( checkReaderError() )
+		return NULL;
+
+	if ( deviceID.isNull() ) {
+		errorString = QString("ImportResponse XML message: no section \"deviceID\" contained!");
+		return NULL;
+	}
+	// finding the correct device
+	USBTechDevice * device = refHubDevice->findDeviceByID( deviceID );
+	logger->trace(QString("processImportResponseMessage dev=%1").arg( deviceID ) );
+	if ( !device ) {
+		errorString = QString("Cannot find USB device with ID=%1 in list of devices - not importing device!").arg( deviceID );
+		return NULL;
+	}
+
+	if ( !hasErrorCode ) {
+		errorString = tr("ImportResponse XML message: no section \"errorCode\" contained!");
+		return NULL;
+	}
+	device->lastOperationErrorCode = errorCode;
+
+	if ( !hasPort ) {
+		errorString = tr("ImportResponse XML message: no section \"port\" contained!");
+		return NULL;
+	}
+	device->connectionPortNum = port;
+	return device;
+}
+
+
+ControlMsg_UnimportRequest* XMLmessageStreamParser::parseUnimportMessage( const QByteArray & message ) {
+	/*
+	 * <unimport>
+	 *   <hostName>horst</hostName>
+	 *   <deviceID type="hex">00e09a81</deviceID>
+	 * </unimport>
+	 */
+	XMLmessageStreamParser parser( message );
+	ControlMsg_UnimportRequest * resultSet = parser.processUnimportRequestMessage();
+	parser.logError();
+	return resultSet;
+}
+
+ControlMsg_UnimportRequest* XMLmessageStreamParser::processUnimportRequestMessage() {
+	if ( !openRootElement("unimport") ) {
+		if ( errorString.isNull() )
+			errorString = QString("XML message is not of type \"unimport\"!");
+		return NULL;
+	}
+
+	ControlMsg_UnimportRequest * resultSet = new ControlMsg_UnimportRequest();
+	resultSet->message = QString::null;
+	bool hasHostname = false, hasDeviceID = false;
+	while ( nextChildElement() ) {
+		if ( isElement("hostName") ) {
+			resultSet->hostname = elementText();
+			hasHostname = true;
+		} else if ( isElement("deviceID") ) {
+			resultSet->deviceID = elementText();
+			hasDeviceID = true;
+		} else if ( isElement("message") )
+			resultSet->message = elementText();
+		else
+			skipElement();
+	}
+
+	if ( !checkReaderError() ) {
+		if ( !hasHostname )
+			errorString = QString("XML message does not contain \"hostName\" element!");
+		else if ( !hasDeviceID )
+			errorString = QString("XML message does not contain \"deviceID\" element!");
+	}
+	if ( !errorString.isNull() ) {
+		delete resultSet;
+		return NULL;
+	}
+	return resultSet;
+}
+
+/* **********************  stream reading ****************** */
+
+bool XMLmessageStreamParser::openRootElement( const char * tagName ) {
+	while ( !reader.atEnd() ) {
+		reader.readNext();
+		if ( reader.isStartElement() )
+			return isElement( tagName );
+	}
+	checkReaderError();
+	return false;
+}
+
+bool XMLmessageStreamParser::nextChildElement() {
+	while ( !reader.atEnd() ) {
+		reader.readNext();
+		if ( reader.isStartElement() ) return true;
+		if ( reader.isEndElement() ) return false;
+	}
+	return false;
+}
+
+bool XMLmessageStreamParser::isElement( const char * tagName ) {
+	return reader.name() == tagName;
+}
+
+QString XMLmessageStreamParser::elementText() {
+	QString text = reader.readElementText();
+	// empty element is "present" (as opposed to a missing element)
+	if ( text.isNull() ) return QString("");
+	return text;
+}
+
+int XMLmessageStreamParser::elementIntValue( const QString & defaultFormat, int defaultValue ) {
+	// attribute has to be taken before reading text (reader moves to end of element)
+	QString typeAtt = reader.attributes().value("type").toString();
+	if ( typeAtt.isEmpty() ) typeAtt = defaultFormat;
+	return unmarshallIntValue( reader.readElementText(), typeAtt, defaultValue );
+}
+
+void XMLmessageStreamParser::skipElement() {
+	int depth = 1;
+	while ( depth > 0 && !reader.atEnd() ) {
+		reader.readNext();
+		if ( reader.isStartElement() ) depth++;
+		else if ( reader.isEndElement() ) depth--;
+	}
+}
+
+bool XMLmessageStreamParser::checkReaderError() {
+	if ( !reader.hasError() ) return false;
+	errorString = QString("Parse error at line %1, column %2: %3")
+			.arg(reader.lineNumber())
+			.arg(reader.columnNumber())
+			.arg(reader.errorString());
+	return true;
+}
+
+void XMLmessageStreamParser::logError() {
+	if ( !errorString.isNull() && logger->isDebugEnabled() )
+		logger->debug( errorString );
+}
+
+/* **********************  changes of devices ****************** */
+
+XMLmessageStreamParser::DeviceState_t XMLmessageStreamParser::deviceState( const USBTechDevice * device ) {
+	DeviceState_t state;
+	state.isValid = device->isValid;
+	state.deviceID = device->deviceID;
+	state.status = device->status;
+	state.owned = device->owned;
+	state.claimedByName = device->claimedByName;
+	return state;
+}
+
+void XMLmessageStreamParser::appendDeviceDelta( USBTechDevice * device, const DeviceState_t & before ) {
+	bool sameDevice = before.isValid && device->isValid &&
+			before.deviceID.compare( device->deviceID, Qt::CaseInsensitive ) == 0;
+	if ( before.isValid && !sameDevice )
+		appendDeviceDelta( ControlMsg_DeviceDelta::DD_REMOVED, before.deviceID, device );
+	if ( !device->isValid ) return;
+	if ( !sameDevice )
+		appendDeviceDelta( ControlMsg_DeviceDelta::DD_ADDED, device->deviceID, device );
+	else if ( before.status != device->status || before.owned != device->owned ||
+			before.claimedByName != device->claimedByName )
+		appendDeviceDelta( ControlMsg_DeviceDelta::DD_CLAIM_CHANGED, device->deviceID, device );
+	else
+		appendDeviceDelta( ControlMsg_DeviceDelta::DD_UNCHANGED, device->deviceID, device );
+}
+
+void XMLmessageStreamParser::appendDeviceDelta( int type, const QString & deviceID, USBTechDevice * device ) {
+	ControlMsg_DeviceDelta delta;
+	delta.type = (ControlMsg_DeviceDelta::eDeltaType) type;
+	delta.deviceID = deviceID;
+	delta.device = device;
+	deltas.append( delta );
+}
+
+/* **********************  some utility methods ****************** */
+
+int XMLmessageStreamParser::unmarshallIntValue( const QString & value, const QString & numFormat, int defaultValue ) {
+	bool forceInt = false;
+	if ( numFormat.isNull() || numFormat.isEmpty() )
+		forceInt = true;
+	bool convOk;
+	if ( forceInt || numFormat.startsWith("int", Qt::CaseInsensitive ) ) {
+		int retVal = value.toInt( &convOk );
+		if ( convOk ) return retVal;
+		else return defaultValue;
+	} else if ( numFormat.startsWith("hex", Qt::CaseInsensitive ) ) {
+		int retVal = value.toInt( &convOk, 16 );
+		if ( convOk ) return retVal;
+		else return defaultValue;
+	}
+	return defaultValue;
+}
+
+QString XMLmessageStreamParser::unmarshallBCDversionValue( const QString & value, const QString & defaultValue ) {
+	QString retValue = QString(defaultValue);
+	if ( value.isNull() || value.isEmpty() ) {
+		return retValue;
+	}
+	int major = 0;
+	int minor = 0;
+	int subMinor = 0;
+	bool isOK = true;
+	if ( value.length() > 1 )
+		major = value.left(2).toInt( &isOK, 16 );
+	if ( value.length() > 2 )
+		minor = value.mid(2,1).toInt( &isOK, 16 );
+	if ( value.length() > 3 )
+		subMinor = value.mid(3,1).toInt( &isOK, 16 );
+	if ( subMinor > 0 )
+		retValue = QString("%1.%2.%3").arg(major).arg(minor).arg(subMinor);
+	else
+		retValue = QString("%1.%2").arg(major).arg(minor);
+	return retValue;
+}
+
+int XMLmessageStreamParser::interpretPlugStatus( const QString & statusText ) {
+	if ( statusText.isNull() ) return USBTechDevice::PS_NotAvailable;
+
+	// in firmware version 1.0.13 status field is "pluged" -
+	// maybe someone corrects this in a future firmware...
+	if ( statusText == "pluged" || statusText == "plugged" )
+		return USBTechDevice::PS_Plugged;
+	else if ( statusText == "unpluged" || statusText == "unplugged" )
+		return USBTechDevice::PS_Unplugged;
+	else if ( statusText == "imported" )
+		return USBTechDevice::PS_Claimed;
+	else if ( statusText == "importing" )
+		return USBTechDevice::PS_Claimed;	// using "Claimed" also for "importing" state, cause there's no difference (?)...
+	else
+		return USBTechDevice::PS_NotAvailable;
+}
@@ -0,0 +1,110 @@
+/*
+ * XMLmessageStreamParser.h
+ * Parser of XML messages of control channel: message is read in one forward pass
+ * (<tt>QXmlStreamReader</tt>) and values are put into <tt>HubDevice</tt> / <tt>USBTechDevice</tt>
+ * directly - no DOM tree is created.
+ *
+ * @author:		Sebastian Kolbe-Nusser &lt;Sebastian DOT Kolbe AT gmail DOT com&gt;
+ * @version:	$Id$
+ * @created:	2011-05-10
+ */
+
+#ifndef XMLMESSAGESTREAMPARSER_H_
+#define XMLMESSAGESTREAMPARSER_H_
+
+#include <QObject>
+#include <QByteArray>
+#include <QList>
+#include <QXmlStreamReader>
+
+class HubDevice;
+class ControlMsg_DiscoveryResponse;
+class ControlMsg_UnimportRequest;
+class ControlMsg_DeviceDelta;
+class USBTechDevice;
+class USBTechInterface;
+class QStringList;
+class Logger;
+
+class XMLmessageStreamParser : public QObject {
+	Q_OBJECT
+public:
+	virtual ~XMLmessageStreamParser();
+	static ControlMsg_DiscoveryResponse* parseDiscoveryMessage( const QByteArray & message );
+	/**
+	 * Puts values of a <em>ServerInfo</em> message into hub and its devices.<br>
+	 * NOTE: Values are taken while reading - a malformed message may be applied partially.
+	 * @return	Change of every reported device (and of devices not reported anymore)
+	 */
+	static QList<ControlMsg_DeviceDelta> parseServerInfoMessage( const QByteArray & message, HubDevice * refHubDevice );
+	/**
+	 * Puts status of devices of a <em>StatusChanged</em> message into devices of hub.
+	 * @return	Change of every reported device (<tt>DD_UNKNOWN_DEVICE</tt> if device is not known)
+	 */
+	static QList<ControlMsg_DeviceDelta> parseStatusChangedMessage( const QByteArray & message, HubDevice * refHubDevice );
+	/** @return	Device of import response - <tt>NULL</tt> if message is malformed or device is not known */
+	static USBTechDevice * parseImportResponseMessage( const QByteArray & message, HubDevice * refHubDevice );
+	static ControlMsg_UnimportRequest* parseUnimportMessage( const QByteArray & message );
+private:
+	XMLmessageStreamParser( const QByteArray & message );
+
+	ControlMsg_DiscoveryResponse* processDiscoveryMessage();
+	bool processServerInfoMessage( HubDevice * refHubDevice );
+	void processServerInfoDeviceList( HubDevice * refHubDevice );
+	void processServerInfoDeviceSection( HubDevice * refHubDevice );
+	bool processDeviceInterfaceElement( USBTechInterface & refInterface );
+	void processStatusChangedMessage( HubDevice * refHubDevice );
+	USBTechDevice * processImportResponseMessage( HubDevice * refHubDevice );
+	ControlMsg_UnimportRequest* processUnimportRequestMessage();
+
+	/**
+	 * Reads up to root element of message.
+	 * @return	<code>false</code> if message is malformed or root element has a different name
+	 */
+	bool openRootElement( const char * tagName );
+	/**
+	 * Reads up to next child element of current element.
+	 * @return	<code>false</code> if end of current element (or of message) is reached
+	 */
+	bool nextChildElement();
+	/** Current element has given (local) name */
+	bool isElement( const char * tagName );
+	/** Text of current element (never a null string) - reader is placed at end of element */
+	QString elementText();
+	/** Numeric value of current element - format is taken from attribute <tt>type</tt> */
+	int elementIntValue( const QString & defaultFormat, int defaultValue );
+	/** Skips current element including all its children */
+	void skipElement();
+	/** Puts error of stream reader into error string. @return <code>true</code> if there was an error */
+	bool checkReaderError();
+	/** Logs error string (if any) */
+	void logError();
+
+	/** State of a device before message is applied (to find out change of device) */
+	struct DeviceState_t {
+		bool isValid;
+		QString deviceID;
+		int status;
+		bool owned;
+		QString claimedByName;
+	};
+	static DeviceState_t deviceState( const USBTechDevice * device );
+	/** Appends change of device (compared to state before message) to list of deltas */
+	void appendDeviceDelta( USBTechDevice * device, const DeviceState_t & before );
+	void appendDeviceDelta( int type, const QString & deviceID, USBTechDevice * device );
+
+	int unmarshallIntValue( const QString & value, const QString & numFormat = "int", int defaultValue = -1 );
+	QString unmarshallBCDversionValue( const QString & value, const QString & defaultValue );
+	int interpretPlugStatus( const QString & value );
+
+	Logger * logger;
+
+	QXmlStreamReader reader;
+	QString errorString;
+	/** Changes of devices found in message */
+	QList<ControlMsg_DeviceDelta> deltas;
+	/** Ports reported in server info (bit per port) */
+	int reportedPorts;
+};
+
+#endif /* XMLMESSAGESTREAMPARSER_H_ */
@@ -0,0 +1,112 @@
+/*
+ * BufferPool.cpp
+ *
+ * @author:		Sebastian Kolbe-Nusser &lt;Sebastian DOT Kolbe AT gmail DOT com&gt;
+ * @version:	$Id$
+ * @created:	2011-04-24
+ */
+
+#include "BufferPool.h"
+
+PooledBuffer PooledBuffer::allocate( int size ) {
+	PooledBuffer buffer;
+	if ( size < 0 ) return buffer;
+	buffer.data = new char[ size > 0? size : 1 ];
+	buffer.length = size;
+	buffer.capacity = size;
+	return buffer;
+}
+
+PooledBuffer PooledBuffer::borrow( char * data, int length, int capacity ) {
+	PooledBuffer buffer;
+	if ( !data || length < 0 || length > capacity ) return buffer;
+	buffer.data = data;
+	buffer.length = length;
+	buffer.capacity = capacity;
+	buffer.borrowed = true;
+	return buffer;
+}
+
+void PooledBuffer::release() {
+	if ( data && !borrowed ) {
+		if ( pool )
+			pool->release( data );
+		else
+			delete[] data;
+	}
+	data = NULL;
+	length = 0;
+	capacity = 0;
+	pool = NULL;
+	borrowed = false;
+}
+
+BufferPool::BufferPool( int size, int maxFree ) {
+	blockSize = size;
+	maxFreeBlocks = maxFree;
+	blocksInUse = 0;
+	disposed = false;
+	freeBlocks.reserve( maxFreeBlocks );
+}
+
+BufferPool::~BufferPool() {
+	freeAllBlocks();
+}
+
+PooledBuffer BufferPool::acquire( int length ) {
+	PooledBuffer buffer;
+	if ( length < 0 || length > blockSize ) return buffer;
+
+	mutex.lock();
+	if ( !freeBlocks.isEmpty() ) {
+		buffer.data = freeBlocks.last();
+		freeBlocks.remove( freeBlocks.size() - 1 );
+	}
+	blocksInUse++;
+	mutex.unlock();
+
+	// allocation is done outside of lock
+	if ( !buffer.data )
+		buffer.data = new char[ blockSize ];
+	buffer.length = length;
+	buffer.capacity = blockSize;
+	buffer.pool = this;
+	return buffer;
+}
+
+void BufferPool::release( char * block ) {
+	if ( !block ) return;
+	bool deletePool = false;
+	mutex.lock();
+	blocksInUse--;
+	if ( !disposed && freeBlocks.size() < maxFreeBlocks ) {
+		freeBlocks.append( block );
+		block = NULL;
+	}
+	deletePool = disposed && blocksInUse <= 0;
+	mutex.unlock();
+
+	if ( block ) delete[] block;
+	if ( deletePool ) delete this;
+}
+
+int BufferPool::getBlockSize() const {
+	return blockSize;
+}
+
+void BufferPool::dispose() {
+	mutex.lock();
+	disposed = true;
+	// unused blocks are not needed anymore - blocks in use are freed when given back
+	freeAllBlocks();
+	bool deletePool = blocksInUse <= 0;
+	mutex.unlock();
+	if ( deletePool )
+		delete this;
+}
+
+void BufferPool::freeAllBlocks() {
+	for ( int i = 0; i < freeBlocks.size(); i++ )
+		delete[] freeBlocks[i];
+	freeBlocks.clear();
+}
@@ -0,0 +1,84 @@
+/*
+ * BufferPool.h
+ * Pool of fixed size memory blocks. Blocks are reused instead of being allocated
+ * and freed for every message. A block may be given back by any thread.
+ *
+ * @author:		Sebastian Kolbe-Nusser &lt;Sebastian DOT Kolbe AT gmail DOT com&gt;
+ * @version:	$Id$
+ * @created:	2011-04-24
+ */
+
+#ifndef BUFFERPOOL_H_
+#define BUFFERPOOL_H_
+
+#include <QMutex>
+#include <QVector>
+
+class BufferPool;
+
+/**
+ * A buffer taken from a <tt>BufferPool</tt> (or from heap if no pool block is big enough).
+ * Plain value type - the owner has to call <tt>release()</tt> exactly once.
+ */
+struct PooledBuffer {
+	/** Data of buffer (<tt>NULL</tt> for an invalid buffer) */
+	char * data;
+	/** Number of valid bytes */
+	int length;
+	/** Size of allocated data block */
+	int capacity;
+	/** Pool the buffer belongs to (<tt>NULL</tt> if allocated on heap) */
+	BufferPool * pool;
+	/** Data is owned by someone else (e.g. buffer of host URB) - <tt>release()</tt> does not free it */
+	bool borrowed;
+
+	PooledBuffer() : data( NULL ), length( 0 ), capacity( 0 ), pool( NULL ), borrowed( false ) {}
+
+	bool isNull() const { return data == NULL; }
+	/** Allocates a buffer of given size on heap (not pooled) */
+	static PooledBuffer allocate( int size );
+	/** Wraps memory owned by caller (which has to keep it valid until buffer is released) */
+	static PooledBuffer borrow( char * data, int length, int capacity );
+	/** Gives buffer back to its pool (or frees heap memory). Buffer is invalid afterwards. */
+	void release();
+};
+
+class BufferPool {
+public:
+	/**
+	 * @param	blockSize		size of each block
+	 * @param	maxFreeBlocks	number of unused blocks kept for reuse (more blocks given back are freed)
+	 */
+	BufferPool( int blockSize, int maxFreeBlocks );
+
+	/**
+	 * Takes a block out of pool (allocates a new block if pool is empty).
+	 * @param	length	number of bytes needed - must not exceed block size
+	 * @return	buffer with <tt>length</tt> set or an invalid buffer if <tt>length</tt> is too big
+	 */
+	PooledBuffer acquire( int length );
+	/** Gives a block back to pool */
+	void release( char * block );
+	int getBlockSize() const;
+
+	/**
+	 * Owner of pool does not need pool anymore. Blocks still in use may be given back
+	 * later - the pool deletes itself when the last block is given back.
+	 */
+	void dispose();
+
+private:
+	int blockSize;
+	int maxFreeBlocks;
+	/** Number of blocks taken out of pool */
+	int blocksInUse;
+	bool disposed;
+	QMutex mutex;
+	QVector<char*> freeBlocks;
+
+	/** Use <tt>dispose()</tt> */
+	~BufferPool();
+	void freeAllBlocks();
+};
+
+#endif /* BUFFERPOOL_H_ */
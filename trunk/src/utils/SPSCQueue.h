@@ -0,0 +1,102 @@
+/*
+ * SPSCQueue.h
+ * Bounded lock free queue for exactly one producer thread and exactly one consumer thread.
+ * Elements are copied into a fixed ring - there is no allocation after construction.
+ *
+ * @author:		Sebastian Kolbe-Nusser &lt;Sebastian DOT Kolbe AT gmail DOT com&gt;
+ * @version:	$Id$
+ * @created:	2011-04-20
+ */
+
+#ifndef SPSCQUEUE_H_
+#define SPSCQUEUE_H_
+
+#include <QAtomicInt>
+
+/**
+ * Single producer / single consumer ring buffer.<br>
+ * <tt>Capacity</tt> must be a power of two; the queue holds at most <tt>Capacity - 1</tt> elements.
+ * <tt>push()</tt> must only be called by producer thread, <tt>pop()</tt> only by consumer thread.
+ */
+template <typename T, int Capacity>
+class SPSCQueue {
+public:
+	SPSCQueue() : head( 0 ), tail( 0 ) {
+		// compile time check: capacity is a power of two
+		typedef char capacityMustBePowerOfTwo[ ( Capacity > 1 && ( Capacity & (Capacity -1) ) == 0 )? 1 : -1 ];
+		(void) sizeof( capacityMustBePowerOfTwo );
+	}
+
+	/**
+	 * Append an element (producer only).
+	 * @return	<code>false</code> if queue is full
+	 */
+	bool push( const T & item ) {
+		int currentTail = tail;	// only producer writes tail
+		int nextTail = ( currentTail + 1 ) & ( Capacity - 1 );
+		if ( nextTail == head.fetchAndAddAcquire( 0 ) )
+			return false;
+		ring[ currentTail ] = item;
+		// publish element to consumer
+		tail.fetchAndStoreRelease( nextTail );
+		return true;
+	}
+
+	/**
+	 * Append an element (producer only) and tell if consumer needs a wakeup: <tt>wakeup</tt> is
+	 * <code>false</code> if elements posted before are still in queue - consumer takes this
+	 * element with them (consumer drains queue until it is empty).
+	 * @return	<code>false</code> if queue is full
+	 */
+	bool push( const T & item, bool & wakeup ) {
+		int currentTail = tail;	// only producer writes tail
+		int nextTail = ( currentTail + 1 ) & ( Capacity - 1 );
+		wakeup = false;
+		if ( nextTail == head.fetchAndAddAcquire( 0 ) )
+			return false;
+		ring[ currentTail ] = item;
+		// publish element and read position of consumer afterwards (full barrier: see pop())
+		tail.fetchAndStoreOrdered( nextTail );
+		int currentHead = head.fetchAndAddOrdered( 0 );
+		wakeup = ( currentHead == currentTail || currentHead == nextTail );
+		return true;
+	}
+
+	/**
+	 * Remove first element (consumer only).
+	 * @return	<code>false</code> if queue is empty
+	 */
+	bool pop( T & item ) {
+		int currentHead = head;	// only consumer writes head
+		if ( currentHead == tail.fetchAndAddAcquire( 0 ) )
+			return false;
+		item = ring[ currentHead ];
+		// slot may be reused by producer - full barrier: next check for an empty queue must not
+		// be done before producer can see this position (see push() with wakeup)
+		head.fetchAndStoreOrdered( ( currentHead + 1 ) & ( Capacity - 1 ) );
+		return true;
+	}
+
+	/** Snapshot: queue is empty (exact only if called by consumer) */
+	bool isEmpty() const {
+		return (int) head == (int) tail;
+	}
+
+	/** Max. number of elements in queue */
+	int capacity() const {
+		return Capacity - 1;
+	}
+
+private:
+	/** Index of next element to read - written by consumer */
+	QAtomicInt head;
+	/** Index of next free slot - written by producer */
+	QAtomicInt tail;
+	T ring[ Capacity ];
+
+	// not copyable
+	SPSCQueue( const SPSCQueue & );
+	SPSCQueue & operator=( const SPSCQueue & );
+};
+
+#endif /* SPSCQUEUE_H_ */
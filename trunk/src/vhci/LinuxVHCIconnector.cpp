@@ -11,11 +11,16 @@
 #include "../TI_USBhub.h"
 #include "../USButils.h"
 #include "../BasicUtils.h"
+#include "../ConfigManager.h"
+#include "../USBdescriptorCache.h"
 #include <QString>
 #include <QMutex>
-#include <QWaitCondition>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <errno.h>
 
 using namespace std;
 
@@ -24,39 +29,69 @@ extern volatile bool applicationShouldRun;
 // singleton instance initialization
 LinuxVHCIconnector *LinuxVHCIconnector::instance = NULL;
 
-// initialization of synchronization mechanism for kernel work
-QMutex * LinuxVHCIconnector::workInProgressMutex = new QMutex;
-QWaitCondition * LinuxVHCIconnector::workInProgressCondition = new QWaitCondition;
-bool LinuxVHCIconnector::isWorkInProgress = false;
-bool LinuxVHCIconnector::isWaitingForWork = false;
-
 
 LinuxVHCIconnector::LinuxVHCIconnector( QObject* parent )
 		: TI_USB_VHCI( parent ) {
 	instance = this;
-	hcd = NULL;
+	hcds = NULL;
 	shouldRun = false;
 	kernelInterfaceUsable = true; // default: everything should be ok
 
+	// ports are spread over as many host controllers as needed (a root hub has 31 ports at most)
+	numberOfPorts = ConfigManager::getInstance().getIntValue( "vhci.numberOfPorts", LINUX_VHCI_DEFAULT_NUMBER_OF_PORTS );
+	if ( numberOfPorts < 1 ) numberOfPorts = 1;
+	if ( numberOfPorts > LINUX_VHCI_MAX_NUMBER_OF_PORTS ) numberOfPorts = LINUX_VHCI_MAX_NUMBER_OF_PORTS;
+	numberOfHcds = ( numberOfPorts + LINUX_VHCI_MAX_PORTS_PER_HCD - 1 ) / LINUX_VHCI_MAX_PORTS_PER_HCD;
+	holdGracePeriodMillis = ConfigManager::getInstance().getIntValue( "vhci.holdGracePeriod", LINUX_VHCI_DEFAULT_HOLD_GRACE_PERIOD );
+	if ( holdGracePeriodMillis < 0 ) holdGracePeriodMillis = 0;
+	// XXX format of packet tables is not verified with hub firmware: plain data by default
+	isoPacketTable = ConfigManager::getInstance().getBoolValue( WUSB_ISO_PACKET_TABLE_CONFIG_KEY, false );
 
-	numberOfPorts = LINUX_VHCI_DEFAULT_NUMBER_OF_PORTS;		// TODO config!
 	portStatusList = new PortStatusData_t[numberOfPorts];
 	for ( int i = 0; i < numberOfPorts; i++ ) {
+		portStatusList[i].hcdIndex = i / LINUX_VHCI_MAX_PORTS_PER_HCD;
+		portStatusList[i].hcdPort = i % LINUX_VHCI_MAX_PORTS_PER_HCD + 1;
 		portStatusList[i].portOK = false;
 		portStatusList[i].portInUse = false;
 		portStatusList[i].portStatus = TI_USB_VHCI::PORTSTATE_UNKNOWN_STATE;
 		portStatusList[i].portEnumeratedByHost = 0;
 		portStatusList[i].initialConnectDeviceDescriptor = NULL;
 		portStatusList[i].deviceInInitPhase = false;
-		portStatusList[i].lastURBhandle = 0;
 		portStatusList[i].packetCount = 0;
+		portStatusList[i].urbChannel = new URBChannel( i+1 );
+		portStatusList[i].replyEventPending = false;
+		portStatusList[i].descriptorValidationPending = false;
+		portStatusList[i].holdDeadlineMillis = 0L;
+		// one reference per slot of reply ring (limits number of outstanding URBs)
+		portStatusList[i].urbReferences = new URBReference_t[URB_CHANNEL_CAPACITY -1];
+		portStatusList[i].freeURBReferences.reserve( URB_CHANNEL_CAPACITY -1 );
+		for ( int j = 0; j < URB_CHANNEL_CAPACITY -1; j++ ) {
+			portStatusList[i].urbReferences[j].work = NULL;
+			portStatusList[i].urbReferences[j].portID = i+1;
+			portStatusList[i].freeURBReferences.append( &portStatusList[i].urbReferences[j] );
+		}
 	}
 
 	// synchronization mutex
 	connectionRequestQueueMutex = new QMutex;
-	deviceReplyDataQueueMutex = new QMutex;
+	// worker thread waits on one epoll set: wakeup eventfd and reply eventfd of each port
+	wakeupEventFD = ::eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+	workEpollFD = ::epoll_create1( EPOLL_CLOEXEC );
+	if ( workEpollFD >= 0 ) {
+		struct epoll_event event;
+		event.events = EPOLLIN;
+		event.data.u32 = LINUX_VHCI_WAKEUP_EVENT_ID;
+		::epoll_ctl( workEpollFD, EPOLL_CTL_ADD, wakeupEventFD, &event );
+		for ( int i = 0; i < numberOfPorts; i++ ) {
+			event.events = EPOLLIN;
+			event.data.u32 = i;		// port index
+			::epoll_ctl( workEpollFD, EPOLL_CTL_ADD, portStatusList[i].urbChannel->getReplyEventFD(), &event );
+		}
+	}
 
 	nextConnectionRequestDeferValue = 0L;
+	// cache is used by several threads: create it here
+	USBdescriptorCache::getInstance();
 
 	// init logger with root-logger
 	logger = Logger::getLogger("VHCI");
@@ -65,12 +100,15 @@ LinuxVHCIconnector::LinuxVHCIconnector( QObject* parent )
 LinuxVHCIconnector::~LinuxVHCIconnector() {
 	if ( shouldRun )
 		stopWork();
-	if ( hcd ) delete hcd;
+	closeInterface();
 	delete connectionRequestQueueMutex;
-	delete deviceReplyDataQueueMutex;
-	delete workInProgressMutex;
-	delete workInProgressCondition;
-	delete portStatusList;
+	for ( int i = 0; i < numberOfPorts; i++ ) {
+		delete portStatusList[i].urbChannel;
+		delete[] portStatusList[i].urbReferences;
+	}
+	delete[] portStatusList;
+	if ( workEpollFD >= 0 ) ::close( workEpollFD );
+	if ( wakeupEventFD >= 0 ) ::close( wakeupEventFD );
 }
 
 LinuxVHCIconnector* LinuxVHCIconnector::getInstance() {
@@ -78,56 +116,97 @@ LinuxVHCIconnector* LinuxVHCIconnector::getInstance() {
 	return new LinuxVHCIconnector();
 }
 bool LinuxVHCIconnector::isLoaded() {
-	if ( LinuxVHCIconnector::instance && LinuxVHCIconnector::instance->hcd ) return true;
+	if ( LinuxVHCIconnector::instance && LinuxVHCIconnector::instance->hcds ) return true;
 	return false;
 }
 
 bool LinuxVHCIconnector::isConnected() {
-	return hcd != NULL;
+	return hcds != NULL;
 }
 
 void LinuxVHCIconnector::signal_work_enqueued(void* arg, usb::vhci::hcd& from) throw()
 {
-	workInProgressMutex->lock();
-	isWorkInProgress = false;
-	if ( isWaitingForWork ) {
-		isWaitingForWork = false;
-		workInProgressCondition->wakeAll();
+	// called by thread of hcd reading the usb-vhci device: wake up worker
+	// (if worker is not waiting the eventfd stays signaled - there is no lost wakeup)
+	if ( arg ) static_cast<LinuxVHCIconnector*>( arg )->wakeupWorker();
+}
+
+void LinuxVHCIconnector::wakeupWorker() {
+	if ( wakeupEventFD < 0 ) return;
+	uint64_t value = 1;
+	while ( ::write( wakeupEventFD, &value, sizeof(value) ) < 0 && errno == EINTR );
+}
+
+void LinuxVHCIconnector::waitForWork( long timeoutMillis ) {
+	struct epoll_event events[LINUX_VHCI_MAX_EPOLL_EVENTS];
+	int numEvents;
+	do {
+		numEvents = ::epoll_wait( workEpollFD, events, LINUX_VHCI_MAX_EPOLL_EVENTS, (int) timeoutMillis );
+	} while ( numEvents < 0 && errno == EINTR );
+
+	for ( int i = 0; i < numEvents; i++ ) {
+		if ( events[i].data.u32 == LINUX_VHCI_WAKEUP_EVENT_ID ) {
+			// reset wakeup (reply eventfds are reset when draining replies of port)
+			uint64_t value;
+			while ( ::read( wakeupEventFD, &value, sizeof(value) ) < 0 && errno == EINTR );
+		} else if ( (int) events[i].data.u32 < numberOfPorts )
+			portStatusList[ events[i].data.u32 ].replyEventPending = true;
 	}
-	workInProgressMutex->unlock();
 }
 
 bool LinuxVHCIconnector::openInterface() {
-	if ( hcd ) return true;
+	if ( hcds ) return true;
+	usb::vhci::local_hcd ** newHcds = new usb::vhci::local_hcd*[numberOfHcds];
+	for ( int i = 0; i < numberOfHcds; i++ )
+		newHcds[i] = NULL;
 	try {
-		// open interface
-		hcd = new usb::vhci::local_hcd( numberOfPorts );
-		// and connect work finished callback
-		hcd->add_work_enqueued_callback( usb::vhci::hcd::callback( &signal_work_enqueued, NULL ) );
+		// open interface: one host controller for each (up to) 31 ports
+		for ( int i = 0; i < numberOfHcds; i++ ) {
+			int hcdPorts = qMin( LINUX_VHCI_MAX_PORTS_PER_HCD, numberOfPorts - i * LINUX_VHCI_MAX_PORTS_PER_HCD );
+			newHcds[i] = new usb::vhci::local_hcd( hcdPorts );
+			// and connect work finished callback
+			newHcds[i]->add_work_enqueued_callback( usb::vhci::hcd::callback( &signal_work_enqueued, this ) );
+		}
 	} catch ( std::exception &ex ) {
-		hcd = NULL;
+		for ( int i = 0; i < numberOfHcds; i++ )
+			if ( newHcds[i] ) delete newHcds[i];
+		delete[] newHcds;
 		logger->error(QString::fromLatin1("Cannot open virtual host controller device: '%1'").
 				arg( QString(USB_VHCI_DEVICE_FILE) ) ); // QString(ex.what())
 		logger->error("Make sure kernel modules (usb-vhci-hcd AND usb-vhci-iocifc) are loaded!");
 		kernelInterfaceUsable = false;
 		return false;
 	}
-	if ( logger->isInfoEnabled() )
-		logger->info(QString::fromLatin1("Opened virtual usb hcd interface: ID: %1 Bus#: %2").
-				arg( QString::fromStdString( hcd->get_bus_id() ), QString::number(hcd->get_usb_bus_num()) ) );
+	if ( logger->isInfoEnabled() ) {
+		for ( int i = 0; i < numberOfHcds; i++ )
+			logger->info(QString::fromLatin1("Opened virtual usb hcd interface: ID: %1 Bus#: %2 Ports: %3").
+					arg( QString::fromStdString( newHcds[i]->get_bus_id() ), QString::number(newHcds[i]->get_usb_bus_num()),
+							QString::number( newHcds[i]->get_port_count() ) ) );
+	}
+	hcds = newHcds;
 
 	// finished
 	return true;
 }
 
 void LinuxVHCIconnector::closeInterface() {
-	if ( !hcd ) return;
+	if ( !hcds ) return;
 	// TODO check is devices are connected and disconnect them accordingly...
-	delete hcd;
-	hcd = NULL;
+	for ( int i = 0; i < numberOfHcds; i++ )
+		delete hcds[i];
+	delete[] hcds;
+	hcds = NULL;
 	kernelInterfaceUsable = true;
 }
 
+usb::vhci::local_hcd * LinuxVHCIconnector::hcdOfPort( int portID ) {
+	return hcds[ portStatusList[portID-1].hcdIndex ];
+}
+
+int LinuxVHCIconnector::portIDofHcdPort( int hcdIndex, uint8_t hcdPort ) {
+	return hcdIndex * LINUX_VHCI_MAX_PORTS_PER_HCD + hcdPort;
+}
+
 void LinuxVHCIconnector::startWork() {
 	if ( shouldRun ) return;
 	shouldRun = true;
@@ -141,9 +220,9 @@ void LinuxVHCIconnector::stopWork() {
 	shouldRun = false;
 	if ( this->isRunning() ) {
 		if ( !this->wait(200L) ) {
-			workInProgressCondition->wakeAll();
+			wakeupWorker();
 			if ( !this->wait(500L) ) {
-				workInProgressCondition->wakeAll();
+				wakeupWorker();
 			}
 		}
 	}
@@ -153,10 +232,10 @@ void LinuxVHCIconnector::stopWork() {
 }
 
 int LinuxVHCIconnector::connectDevice( USBTechDevice * device, int portID ) {
-	if ( !hcd && !openInterface() ) {
+	if ( !hcds && !openInterface() ) {
 		return -2;
 	}
-	if ( !hcd || !kernelInterfaceUsable ) {
+	if ( !hcds || !kernelInterfaceUsable ) {
 		return -2;
 	}
 	if ( !shouldRun ) startWork();
@@ -169,15 +248,21 @@ int LinuxVHCIconnector::connectDevice( USBTechDevice * device, int portID ) {
 		connRequest.refDevice = device;
 		connRequest.port = portID;
 		connRequest.operationFlag = 1;
-		short bcdUSB = USButils::decodeBCDToShort( connRequest.refDevice->bcdUSB );
-		if ( bcdUSB >= 0x0200 )
-			connRequest.dataRate = usb::data_rate_high;
-		else
-			connRequest.dataRate = usb::data_rate_full;
-
-		QByteArray * deviceDescriptor = new QByteArray(18,'\0');	// device descriptor is always 18 bytes in length
-		createDeviceDescriptorFromDeviceDescription( device, *deviceDescriptor );
+
+		// known device: enumeration is answered from cached descriptors (real device descriptor is
+		// used for probing too) - otherwise a device descriptor is created from device description
+		QByteArray * deviceDescriptor = NULL;
+		if ( USBdescriptorCache::getInstance().find( device->idVendor, device->idProduct,
+				(unsigned short) USButils::decodeBCDToShort( device->bcdDevice ), connRequest.cachedDescriptors ) ) {
+			deviceDescriptor = new QByteArray( connRequest.cachedDescriptors.getDeviceDescriptor() );
+			if ( logger->isInfoEnabled() )
+				logger->info(QString("Using cached descriptors for device %1").arg( connRequest.cachedDescriptors.getKey() ) );
+		} else {
+			deviceDescriptor = new QByteArray(18,'\0');	// device descriptor is always 18 bytes in length
+			createDeviceDescriptorFromDeviceDescription( device, *deviceDescriptor );
+		}
 		connRequest.initialDeviceDescriptor = deviceDescriptor;
+		connRequest.dataRate = determineDataRate( device, connRequest.cachedDescriptors );
 		if ( logger->isDebugEnabled() )
 			logger->debug(QString("Fake init descriptor: %1").arg( messageToString( *deviceDescriptor, 0 ) ) );
 
@@ -193,7 +278,7 @@ int LinuxVHCIconnector::connectDevice( USBTechDevice * device, int portID ) {
 		connectionRequestQueueMutex->unlock();
 
 		// wake up working thread
-		workInProgressCondition->wakeAll();
+		wakeupWorker();
 	}
 	return portID;
 }
@@ -211,10 +296,65 @@ bool LinuxVHCIconnector::disconnectDevice( int portID ) {
 	deviceConnectionRequestQueue.enqueue( connRequest );
 	connectionRequestQueueMutex->unlock();
 	// wake up working thread
-	workInProgressCondition->wakeAll();
+	wakeupWorker();
+	return true;
+}
+
+bool LinuxVHCIconnector::holdPort( int portID ) {
+	if ( portID < 1 || portID > numberOfPorts || holdGracePeriodMillis <= 0 ) return false;
+	QMutexLocker locker( connectionRequestQueueMutex );
+	if ( !portStatusList[portID-1].portInUse ) return false;
+	portStatusList[portID-1].holdDeadlineMillis = currentTimeMillis() + holdGracePeriodMillis;
+	logger->info(QString("Holding device on port %1 for %2 ms").arg(
+			QString::number(portID), QString::number(holdGracePeriodMillis) ) );
+	// worker has to wake up at end of grace period
+	wakeupWorker();
 	return true;
 }
 
+bool LinuxVHCIconnector::releasePort( int portID ) {
+	if ( portID < 1 || portID > numberOfPorts ) return false;
+	QMutexLocker locker( connectionRequestQueueMutex );
+	long long deadline = portStatusList[portID-1].holdDeadlineMillis;
+	// grace period is over: connection worker has to disconnect device
+	if ( deadline <= 0L || currentTimeMillis() >= deadline ) return false;
+	portStatusList[portID-1].holdDeadlineMillis = 0L;
+	logger->info(QString("Device on port %1 released").arg( QString::number(portID) ) );
+	return true;
+}
+
+bool LinuxVHCIconnector::isPortHeld( int portID ) {
+	if ( portID < 1 || portID > numberOfPorts ) return false;
+	QMutexLocker locker( connectionRequestQueueMutex );
+	long long deadline = portStatusList[portID-1].holdDeadlineMillis;
+	return deadline > 0L && currentTimeMillis() < deadline;
+}
+
+long long LinuxVHCIconnector::processExpiredPortHolds() {
+	long long nextDeadline = 0L;
+	long long now = currentTimeMillis();
+	QList<int> expiredPorts;
+	connectionRequestQueueMutex->lock();
+	for ( int i = 0; i < numberOfPorts; i++ ) {
+		long long deadline = portStatusList[i].holdDeadlineMillis;
+		if ( deadline <= 0L ) continue;
+		if ( now >= deadline ) {
+			portStatusList[i].holdDeadlineMillis = 0L;
+			expiredPorts.append( i+1 );
+		} else if ( nextDeadline == 0L || deadline < nextDeadline )
+			nextDeadline = deadline;
+	}
+	connectionRequestQueueMutex->unlock();
+
+	// Answers of a port must be given back by one thread only: URBs queued in channel meanwhile
+	// (and URBs kept by network stack) are given back by network stack when connection worker
+	// disconnects the device - port stays in use until then.
+	for ( int i = 0; i < expiredPorts.size(); i++ )
+		logger->warn(QString("Device on port %1 not reconnected within %2 ms - waiting for disconnect").arg(
+				QString::number(expiredPorts[i]), QString::number(holdGracePeriodMillis) ) );
+	return nextDeadline;
+}
+
 int LinuxVHCIconnector::getAndReservePortID() {
 	int portID = getUnusedPort();
 	portStatusList[portID-1].portInUse = true;// mark port as used
@@ -237,6 +377,27 @@ int LinuxVHCIconnector::getUnusedPort() {
  * device enumeration. Typically after this "probe" the port will perform a reset and
  * normal operation can begin (this will usually start by querying the device descriptor...).
  */
+usb::data_rate LinuxVHCIconnector::determineDataRate( USBTechDevice * device, const USBdescriptorSet & descriptors ) {
+	switch ( descriptors.getDeviceSpeed() ) {
+	case USBdescriptorSet::SPEED_HIGH:
+		return usb::data_rate_high;
+	case USBdescriptorSet::SPEED_FULL:
+		return usb::data_rate_full;
+	case USBdescriptorSet::SPEED_LOW:
+		return usb::data_rate_low;
+	case USBdescriptorSet::SPEED_UNKNOWN:
+		break;
+	}
+	// fallback: USB 2.0 devices are assumed to run at high speed
+	if ( logger->isDebugEnabled() )
+		logger->debug(QString("Data rate of device %1:%2 not known from descriptors - using USB version %3").arg(
+				QString::number( device->idVendor, 16 ), QString::number( device->idProduct, 16 ), device->bcdUSB ) );
+	short bcdUSB = USButils::decodeBCDToShort( device->bcdUSB );
+	if ( bcdUSB >= 0x0200 )
+		return usb::data_rate_high;
+	return usb::data_rate_full;
+}
+
 void LinuxVHCIconnector::createDeviceDescriptorFromDeviceDescription( USBTechDevice * device, QByteArray & bytes ) {
 	if ( !device ) return;
 	// Creating an standard device descriptor
@@ -318,7 +479,10 @@ void LinuxVHCIconnector::createURBfromInternalStruct( usb::urb * urbData, QByteA
 		}
 	} else {
 		int lenData = urbData->get_buffer_actual();
-		buffer.reserve(lenData);	// reserve at least length of data section
+		// isochronous transfer: packet table precedes data
+		if ( isoPacketTable && urbData->is_isochronous() )
+			appendIsoPacketTable( urbData, buffer );
+		buffer.reserve( buffer.size() + lenData );	// reserve at least length of data section
 		// additional data to transfer: copy to buffer
 		if ( lenData >  0 ) {
 			uint8_t* dataBuf = urbData->get_buffer();
@@ -368,21 +532,51 @@ void LinuxVHCIconnector::createURBfromInternalStruct( usb::urb * urbData, QByteA
 }
 
 void LinuxVHCIconnector::giveBackAnswerURB( void * refData, bool isOK, QByteArray * urbData ) {
-//	printf("XXX giveBackAnswerURB isOK=%s!\n", (isOK?"1":"0") );
-
-	usb::vhci::process_urb_work * refURB = reinterpret_cast<usb::vhci::process_urb_work*>(refData);
-	if ( !refURB ) return;
+	URBReply_t replyData;
+	replyData.refData = refData;
+	replyData.status = ( isOK ? DEVICE_ANSWER_OK : DEVICE_ANSWER_ERROR );
+	replyData.urbData = urbData;
+	postURBreply( replyData );
+}
 
-	struct DeviceURBreplyData replyData;
+void LinuxVHCIconnector::giveBackAnswerURB( void * refData, bool isOK, const PooledBuffer & urbData ) {
+	URBReply_t replyData;
+	replyData.refData = refData;
 	replyData.status = ( isOK ? DEVICE_ANSWER_OK : DEVICE_ANSWER_ERROR );
-	replyData.refURB = refURB;
-	replyData.dataURB = urbData;
+	replyData.urbData = NULL;
+	replyData.pooledData = urbData;
+	postURBreply( replyData );
+}
 
-	deviceReplyDataQueueMutex->lock();
-	deviceReplyDataQueue.enqueue( replyData );
-	deviceReplyDataQueueMutex->unlock();
-	// wake up working thread
-	workInProgressCondition->wakeAll();
+PooledBuffer LinuxVHCIconnector::reserveAnswerBuffer( void * refData, int length ) {
+	URBReference_t * urbRef = reinterpret_cast<URBReference_t*>(refData);
+	if ( !urbRef || !urbRef->work || length <= 0 ) return PooledBuffer();
+	usb::urb * urbOrig = urbRef->work->get_urb();
+	// buffer of URB is valid until work is finished (after reply was processed by worker thread);
+	// isochronous answers with a packet table have to be unpacked
+	if ( !urbOrig || ( isoPacketTable && urbOrig->is_isochronous() ) || !urbOrig->is_in() ||
+			length > urbOrig->get_buffer_length() )
+		return PooledBuffer();
+	return PooledBuffer::borrow( reinterpret_cast<char*>( urbOrig->get_buffer() ), length, urbOrig->get_buffer_length() );
+}
+
+void LinuxVHCIconnector::postURBreply( URBReply_t & replyData ) {
+	URBReference_t * urbRef = reinterpret_cast<URBReference_t*>(replyData.refData);
+	URBChannel * channel = urbRef? getURBChannel( urbRef->portID ) : NULL;
+
+	// posting wakes up working thread
+	if ( !channel || !channel->postReply( replyData ) ) {
+		// cannot happen: number of outstanding URBs is limited by size of reply ring
+		if ( urbRef )
+			logger->error(QString("Cannot pass URB reply to host (port %1)").arg( QString::number( urbRef->portID ) ) );
+		if ( replyData.urbData ) delete replyData.urbData;
+		replyData.pooledData.release();
+	}
+}
+
+URBChannel * LinuxVHCIconnector::getURBChannel( int portID ) {
+	if ( portID < 1 || portID > numberOfPorts ) return NULL;
+	return portStatusList[portID-1].urbChannel;
 }
 
 bool LinuxVHCIconnector::processOutstandingConnectionRequests() {
@@ -395,19 +589,17 @@ bool LinuxVHCIconnector::processOutstandingConnectionRequests() {
 	}
 
 	connectionRequestQueueMutex->lock();
-	if ( deviceConnectionRequestQueue.isEmpty() ) return false;
+	if ( deviceConnectionRequestQueue.isEmpty() ) {
+		connectionRequestQueueMutex->unlock();
+		return false;
+	}
 	struct DeviceConnectionData_t connRequest = deviceConnectionRequestQueue.dequeue();
 	connectionRequestQueueMutex->unlock();
 
 	if ( connRequest.operationFlag == 2 ) {
 		// disconnect operation
 		if ( connRequest.port <= 0 ) return false;
-		if ( portStatusList[connRequest.port -1].lastURBhandle ) {
-			hcd->cancel_process_urb_work( portStatusList[connRequest.port -1].lastURBhandle );
-		}
-		hcd->port_disconnect( connRequest.port );
-		portStatusList[connRequest.port -1].portInUse = false;
-		portStatusList[connRequest.port -1].lastURBhandle = 0L;
+		disconnectPort( connRequest.port );
 	} else {
 		// connect operation
 		if ( connRequest.port <= 0 )
@@ -428,10 +620,13 @@ bool LinuxVHCIconnector::processOutstandingConnectionRequests() {
 			}
 			portStatusList[connRequest.port -1].initialConnectDeviceDescriptor = connRequest.initialDeviceDescriptor;
 			portStatusList[connRequest.port -1].deviceInInitPhase = true;
+			portStatusList[connRequest.port -1].cachedDescriptors = connRequest.cachedDescriptors;
+			portStatusList[connRequest.port -1].capturedDescriptors.clear();
+			portStatusList[connRequest.port -1].descriptorValidationPending = false;
 
 			logger->info( QString("Connecting device on port %1 with datarate %2").arg(
 					QString::number(connRequest.port), datarateStr ) );
-			hcd->port_connect( connRequest.port, connRequest.dataRate );
+			hcdOfPort( connRequest.port )->port_connect( portStatusList[connRequest.port -1].hcdPort, connRequest.dataRate );
 		} else {
 			// XXX connect later depends on additional work done in connectDevice method! -> still to do
 			nextConnectionRequestDeferValue = currentTimeMillis() + 10000L;	// next try in 10 secs
@@ -446,290 +641,522 @@ bool LinuxVHCIconnector::processOutstandingConnectionRequests() {
 	return true;
 }
 
+void LinuxVHCIconnector::disconnectPort( int portID ) {
+	// URBs still outstanding are canceled - they are finished when network stack gives them back
+	usb::vhci::local_hcd * hcd = hcdOfPort( portID );
+	QHashIterator<uint64_t, URBReference_t*> it( portStatusList[portID -1].outstandingURBs );
+	while ( it.hasNext() ) {
+		it.next();
+		hcd->cancel_process_urb_work( it.key() );
+	}
+	hcd->port_disconnect( portStatusList[portID -1].hcdPort );
+	connectionRequestQueueMutex->lock();
+	portStatusList[portID -1].portInUse = false;
+	portStatusList[portID -1].holdDeadlineMillis = 0L;
+	connectionRequestQueueMutex->unlock();
+	storeCapturedDescriptors( portID );
+	portStatusList[portID -1].cachedDescriptors.clear();
+	portStatusList[portID -1].descriptorValidationPending = false;
+}
+
+/** Little endian helpers for isochronous packet table */
+static void writeLE32( QByteArray & buffer, uint32_t value ) {
+	buffer.append( (char) ( value & 0xff ) );
+	buffer.append( (char) ( ( value >> 8 ) & 0xff ) );
+	buffer.append( (char) ( ( value >> 16 ) & 0xff ) );
+	buffer.append( (char) ( ( value >> 24 ) & 0xff ) );
+}
+
+static uint32_t readLE32( const char * data ) {
+	const uint8_t * bytes = (const uint8_t *) data;
+	return bytes[0] | ( bytes[1] << 8 ) | ( bytes[2] << 16 ) | ( (uint32_t) bytes[3] << 24 );
+}
+
+void LinuxVHCIconnector::appendIsoPacketTable( usb::urb * urbData, QByteArray & buffer ) {
+	int32_t packetCount = urbData->get_iso_packet_count();
+	if ( packetCount < 0 ) packetCount = 0;
+	buffer.reserve( buffer.size() + WUSB_ISO_TABLE_HEADER_LEN + packetCount * WUSB_ISO_PACKET_DESCRIPTOR_LEN );
+	writeLE32( buffer, packetCount );
+	for ( int32_t i = 0; i < packetCount; i++ ) {
+		writeLE32( buffer, urbData->get_iso_packet_offset( i ) );
+		writeLE32( buffer, urbData->get_iso_packet_length( i ) );
+	}
+}
+
+void LinuxVHCIconnector::completeIsoURB( usb::urb * urbData, const char * answer, int answerLength ) {
+	int32_t packetCount = urbData->get_iso_packet_count();
+	int tableLength = WUSB_ISO_TABLE_HEADER_LEN + packetCount * WUSB_ISO_PACKET_DESCRIPTOR_LEN;
+	if ( !answer || answerLength < tableLength || (int32_t) readLE32( answer ) != packetCount ) {
+		// no (usable) answer - e.g. frame dropped because it was too late
+		for ( int32_t i = 0; i < packetCount; i++ ) {
+			urbData->set_iso_packet_actual( i, 0 );
+			urbData->set_iso_packet_status( i, USB_VHCI_STATUS_TIMEDOUT );
+		}
+		urbData->set_iso_error_count( packetCount );
+		urbData->set_buffer_actual( 0 );
+		urbData->ack();
+		return;
+	}
+
+	uint8_t * buffer = urbData->get_buffer();
+	int bufferLength = urbData->get_buffer_length();
+	const char * packetData = answer + tableLength;
+	int dataLeft = answerLength - tableLength;
+	int errorCount = 0;
+	int totalActual = 0;
+	for ( int32_t i = 0; i < packetCount; i++ ) {
+		const char * descriptor = answer + WUSB_ISO_TABLE_HEADER_LEN + i * WUSB_ISO_PACKET_DESCRIPTOR_LEN;
+		int actual = (int) readLE32( descriptor );
+		int32_t status = (int32_t) readLE32( descriptor + 4 );
+		// actual length never exceeds packet buffer (nor received data)
+		actual = qBound( 0, actual, (int) urbData->get_iso_packet_length( i ) );
+		if ( urbData->is_in() ) {
+			int offset = urbData->get_iso_packet_offset( i );
+			actual = qMin( actual, qMin( dataLeft, bufferLength - offset ) );
+			if ( actual < 0 ) actual = 0;
+			if ( actual > 0 )
+				std::copy( packetData, packetData + actual, buffer + offset );
+			packetData += actual;
+			dataLeft -= actual;
+		}
+		urbData->set_iso_packet_actual( i, actual );
+		urbData->set_iso_packet_status( i, status );
+		if ( status != USB_VHCI_STATUS_SUCCESS ) errorCount++;
+		totalActual += actual;
+	}
+	urbData->set_iso_error_count( errorCount );
+	urbData->set_buffer_actual( urbData->is_in()? totalActual : urbData->get_buffer_actual() );
+	urbData->ack();
+}
+
 bool LinuxVHCIconnector::processOutstandingURBReplys() {
-	if ( deviceReplyDataQueue.isEmpty() ) return false;
-	deviceReplyDataQueueMutex->lock();
-	if ( deviceReplyDataQueue.isEmpty() ) return false;
-	while ( !deviceReplyDataQueue.isEmpty() ) {
-		struct DeviceURBreplyData replyData = deviceReplyDataQueue.dequeue();
-		int portID = replyData.refURB->get_port();
-
-		if ( portStatusList[portID-1].lastURBhandle )
-			portStatusList[portID-1].lastURBhandle = 0;
-		try {
-			usb::urb * urbOrig = replyData.refURB->get_urb();
-			if ( replyData.status == DEVICE_ANSWER_OK ) {
-				int lenMax = urbOrig->get_buffer_length();
-				if ( replyData.dataURB && replyData.dataURB->length() > 0 ) {
-					uint8_t* buffer( urbOrig->get_buffer() );	// get buffer from URB struct
-					if( replyData.dataURB->length() < lenMax ) lenMax = replyData.dataURB->length();
-					const char* replyRawData = replyData.dataURB->constData();
-					std::copy( replyRawData, replyRawData + lenMax, buffer );	// copy data
-					urbOrig->set_buffer_actual( lenMax );
+	bool processed = false;
+	for ( int portIdx = 0; portIdx < numberOfPorts; portIdx++ ) {
+		// only ports signaled by their reply eventfd need to be drained
+		if ( !portStatusList[portIdx].replyEventPending ) continue;
+		portStatusList[portIdx].replyEventPending = false;
+		URBChannel * channel = portStatusList[portIdx].urbChannel;
+		channel->clearReplyEvent();
+		URBReply_t replyData;
+		while ( channel->takeReply( replyData ) ) {
+			processed = true;
+			URBReference_t * urbRef = reinterpret_cast<URBReference_t*>(replyData.refData);
+			usb::vhci::process_urb_work * refURB = urbRef->work;
+			int portID = portIdx + 1;
+
+			if ( !refURB ) {
+				// request of connector itself (not from host)
+				validateCachedDescriptors( portID, replyData );
+				portStatusList[portIdx].freeURBReferences.append( urbRef );
+				if ( replyData.urbData )
+					delete replyData.urbData;
+				replyData.pooledData.release();
+				continue;
+			}
 
+			try {
+				usb::urb * urbOrig = refURB->get_urb();
+				if ( portStatusList[portIdx].outstandingURBs.remove( urbOrig->get_handle() ) > 0 ) {
+					uint8_t endpointAddr = urbOrig->get_endpoint_address();
+					if ( --portStatusList[portIdx].outstandingURBsByEndpoint[endpointAddr] <= 0 )
+						portStatusList[portIdx].outstandingURBsByEndpoint.remove( endpointAddr );
+				}
+				if ( refURB->is_canceled() ) {
+					// host is not interested in answer anymore
 					if ( logger->isDebugEnabled() )
-						logger->debug(QString("VHCIconn: Replypacket (len=%1): %2").arg(
-								QString::number( lenMax ),
-								messageToString( buffer, lenMax )) );
+						logger->debug(QString("URB reply: URB on port %1 was canceled").arg( QString::number( portID ) ) );
+				} else if ( isoPacketTable && urbOrig->is_isochronous() ) {
+					// isochronous URB: every packet has its own status and length
+					const char * replyRawData = replyData.urbData? replyData.urbData->constData() : replyData.pooledData.data;
+					int replyLength = replyData.urbData? replyData.urbData->length() : replyData.pooledData.length;
+					if ( replyData.status != DEVICE_ANSWER_OK )
+						replyRawData = NULL;
+					completeIsoURB( urbOrig, replyRawData, replyLength );
+				} else if ( replyData.status == DEVICE_ANSWER_OK ) {
+					int lenMax = urbOrig->get_buffer_length();
+					// answer data is either a pooled buffer (network stack) or a byte array
+					const char* replyRawData = replyData.pooledData.data;
+					int replyLength = replyData.pooledData.length;
+					if ( replyData.urbData ) {
+						replyRawData = replyData.urbData->constData();
+						replyLength = replyData.urbData->length();
+					}
+					if ( replyRawData && replyLength > 0 ) {
+						uint8_t* buffer( urbOrig->get_buffer() );	// get buffer from URB struct
+						if( replyLength < lenMax ) lenMax = replyLength;
+						// answer may have been reassembled in URB buffer already (see reserveAnswerBuffer)
+						if ( replyRawData != reinterpret_cast<const char*>( buffer ) )
+							std::copy( replyRawData, replyRawData + lenMax, buffer );	// copy data
+						urbOrig->set_buffer_actual( lenMax );
+
+						if ( logger->isDebugEnabled() )
+							logger->debug(QString("VHCIconn: Replypacket (len=%1): %2").arg(
+									QString::number( lenMax ),
+									messageToString( buffer, lenMax )) );
+					}
+					if ( urbOrig->is_control() )
+						captureDescriptor( portID, urbOrig );
+					if ( logger->isDebugEnabled() )
+						logger->debug(QString("URB reply: URB %1 - Sending ACK, buffer length=%2").arg(
+								QString::number( portStatusList[portID-1].packetCount ),
+								QString::number(lenMax) ) );
+					urbOrig->ack();
+				} else {
+					logger->debug(QString("URB reply: Sending Error"));
+					urbOrig->set_status( USB_VHCI_STATUS_ERROR );
 				}
-				logger->debug(QString("URB reply: URB %1 - Sending ACK, buffer length=%2").arg(
-						QString::number( portStatusList[portID-1].packetCount ),
-						QString::number(lenMax) ) );
-				urbOrig->ack();
-			} else {
-				logger->debug(QString("URB reply: Sending Error"));
-				urbOrig->set_status( USB_VHCI_STATUS_ERROR );
+				hcds[ portStatusList[portIdx].hcdIndex ]->finish_work( refURB );
+			} catch ( std::exception &ex ) {
+				logger->error( QString::fromLatin1("Exception caught while passing USB reply to host - Error: %1").
+						arg( QString(ex.what()) ) );
 			}
-			hcd->finish_work( replyData.refURB );
-		} catch ( std::exception &ex ) {
-			logger->error( QString::fromLatin1("Exception caught while passing USB reply to host - Error: %1").
-					arg( QString(ex.what()) ) );
-		}
+			portStatusList[portIdx].freeURBReferences.append( urbRef );
 
-		if ( replyData.dataURB )
-			delete replyData.dataURB;
+			if ( replyData.urbData )
+				delete replyData.urbData;
+			replyData.pooledData.release();
+		}
 	}
-	deviceReplyDataQueueMutex->unlock();
+	return processed;
+}
 
+bool LinuxVHCIconnector::answerFromDescriptorCache( int portID, usb::urb * urbData ) {
+	if ( portStatusList[portID-1].cachedDescriptors.isEmpty() ) return false;
+	// GET_DESCRIPTOR (standard request to device)
+	if ( urbData->get_bmRequestType() != 0x80 || urbData->get_bRequest() != 0x06 ) return false;
+	QByteArray answer;
+	int lenMax = qMin( (int) urbData->get_wLength(), (int) urbData->get_buffer_length() );
+	if ( !portStatusList[portID-1].cachedDescriptors.lookup( urbData->get_wValue(), urbData->get_wIndex(), lenMax, answer ) )
+		return false;
+	std::copy( answer.constData(), answer.constData() + answer.size(), urbData->get_buffer() );
+	urbData->set_buffer_actual( answer.size() );
+	urbData->ack();
+	if ( logger->isDebugEnabled() )
+		logger->debug(QString("Port %1: descriptor 0x%2 (index 0x%3) answered from cache").arg(
+				QString::number( portID ), QString::number( urbData->get_wValue(), 16 ), QString::number( urbData->get_wIndex(), 16 ) ) );
+	if ( !portStatusList[portID-1].descriptorValidationPending )
+		requestDescriptorValidation( portID );
 	return true;
 }
 
+void LinuxVHCIconnector::requestDescriptorValidation( int portID ) {
+	// device descriptor is read from device in background and compared with cached one
+	if ( portStatusList[portID-1].freeURBReferences.isEmpty() ) return;
+	URBReference_t * urbRef = portStatusList[portID-1].freeURBReferences.last();
+	urbRef->work = NULL;
+	URBDescriptor_t request;
+	request.refData = urbRef;
+	request.cancelRequest = false;
+	request.transferFlags = 0;
+	request.endpoint = 0;
+	request.transferType = TI_WusbStack::CONTROL_TRANSFER;
+	request.direction = TI_WusbStack::DATADIRECTION_IN;
+	request.intervalVal = 0;
+	request.expectedReceiveLength = 18;
+	request.urbData = new QByteArray( USButils::createGetDescriptor_Device() );
+	if ( portStatusList[portID-1].urbChannel->postRequest( request ) ) {
+		portStatusList[portID-1].freeURBReferences.remove( portStatusList[portID-1].freeURBReferences.size() - 1 );
+		portStatusList[portID-1].descriptorValidationPending = true;
+	} else
+		delete request.urbData;
+}
+
+void LinuxVHCIconnector::validateCachedDescriptors( int portID, const URBReply_t & replyData ) {
+	if ( !portStatusList[portID-1].descriptorValidationPending ) return;
+	portStatusList[portID-1].descriptorValidationPending = false;
+	if ( replyData.status != DEVICE_ANSWER_OK ) return;	// device not reachable: nothing to compare
+	QByteArray deviceDescriptor = replyData.urbData? *replyData.urbData :
+			QByteArray( replyData.pooledData.data, replyData.pooledData.length );
+	const USBdescriptorSet & cachedDescriptors = portStatusList[portID-1].cachedDescriptors;
+	if ( cachedDescriptors.isEmpty() || deviceDescriptor == cachedDescriptors.getDeviceDescriptor() ) return;
+	// device was changed (e.g. firmware update): cache entry must not be used anymore
+	logger->warn(QString("Cached descriptors of device on port %1 do not match device - cache entry dropped").arg(
+			QString::number( portID ) ) );
+	USBdescriptorCache::getInstance().remove( cachedDescriptors );
+	portStatusList[portID-1].cachedDescriptors.clear();
+}
+
+void LinuxVHCIconnector::captureDescriptor( int portID, usb::urb * urbData ) {
+	if ( urbData->get_bmRequestType() == 0x80 && urbData->get_bRequest() == 0x06 ) {
+		// answer of GET_DESCRIPTOR from device
+		portStatusList[portID-1].capturedDescriptors.insert( urbData->get_wValue(), urbData->get_wIndex(),
+				QByteArray( (const char*) urbData->get_buffer(), urbData->get_buffer_actual() ) );
+	} else if ( urbData->get_bmRequestType() == 0x00 && urbData->get_bRequest() == 0x09 ) {
+		// SET_CONFIGURATION: enumeration is done
+		storeCapturedDescriptors( portID );
+	}
+}
+
+void LinuxVHCIconnector::storeCapturedDescriptors( int portID ) {
+	USBdescriptorSet & capturedDescriptors = portStatusList[portID-1].capturedDescriptors;
+	// (enumeration answered from cache leaves an incomplete set: cache entry is kept as it is)
+	if ( !capturedDescriptors.isComplete() ) return;
+	USBdescriptorCache::getInstance().store( capturedDescriptors );
+	capturedDescriptors.clear();
+}
+
 void LinuxVHCIconnector::run() {
 	bool cont(false);
-	if ( !kernelInterfaceUsable ) return;	// nothing to do here!
+	if ( !kernelInterfaceUsable || workEpollFD < 0 ) return;	// nothing to do here!
 	while ( applicationShouldRun && shouldRun ) {
-		// Wait if last interaction with kernel still running
-		if ( !cont ) {
-			workInProgressMutex->lock();
-			if ( isWorkInProgress ) {
-				isWaitingForWork = true;
-				workInProgressCondition->wait( workInProgressMutex, 150L );
-				if ( !shouldRun ) return;
-			} else
-				isWorkInProgress = true;
-			workInProgressMutex->unlock();
+		// Block until kernel enqueues work, a network stack posts an answer or a connection
+		// request arrives. If kernel has more work queued, only pick up events without waiting.
+		// holding of ports ends with their grace period
+		long long holdDeadline = processExpiredPortHolds();
+		long timeoutMillis = -1L;
+		if ( cont )
+			timeoutMillis = 0L;
+		else if ( nextConnectionRequestDeferValue > 0L && !deviceConnectionRequestQueue.isEmpty() )
+			// deferred connection request is retried later
+			timeoutMillis = qMax( 0LL, nextConnectionRequestDeferValue - currentTimeMillis() );
+		if ( holdDeadline > 0L && !cont ) {
+			long holdTimeout = (long) qMax( 0LL, holdDeadline - currentTimeMillis() );
+			if ( timeoutMillis < 0L || holdTimeout < timeoutMillis )
+				timeoutMillis = holdTimeout;
 		}
+		waitForWork( timeoutMillis );
+		if ( !shouldRun ) return;
 
 		// process URB replys
 		processOutstandingURBReplys();
-		// process device connect / disconnect operations
-		processOutstandingConnectionRequests();
-
-		// TODO check for memory allocation error / exception
-		// get something to do from host controller
-		try {
-			cont = hcd->next_work(&work);
-		} catch ( std::exception &ex ) {
-			logger->error(QString("Error: %1").arg(QString(ex.what())));
+		// process device connect / disconnect operations (all of them: there is no periodic wakeup)
+		while ( processOutstandingConnectionRequests() );
+
+		// get something to do from each host controller
+		cont = false;
+		for ( int hcdIndex = 0; hcdIndex < numberOfHcds; hcdIndex++ ) {
+			usb::vhci::work * work = NULL;
+			// TODO check for memory allocation error / exception
+			try {
+				if ( hcds[hcdIndex]->next_work(&work) ) cont = true;
+			} catch ( std::exception &ex ) {
+				logger->error(QString("Error: %1").arg(QString(ex.what())));
+			}
+			if ( work )
+				processWork( hcdIndex, work );
 		}
-		if ( work ) {
-			if ( usb::vhci::port_stat_work* psw = dynamic_cast<usb::vhci::port_stat_work*>(work) ) {
-				// Host changes status of port
-				uint8_t portID = psw->get_port();
-				if( psw->triggers_power_off() ) {
-					logger->info(QString("USB Port #%1 powered off").
-							arg(QString::number(portID)));
-					portStatusList[ portID -1 ].portStatus = TI_USB_VHCI::PORTSTATE_DISABLED;
-					if ( portStatusList[ portID -1 ].portInUse ) {
-						// port is in use by us!
-						// TODO send signal and disconnect all devices
-						//						logger->info(QString("port #%1 not in use?").arg( QString::number(portID) ) );
-						portStatusList[portID-1].deviceInInitPhase = true;
-					}
-				}
-				if ( psw->triggers_reset() ) {
-					logger->info(QString("USB Port #%1 reset").
-							arg(QString::number(portID)));
-					// portStatusList[ portID -1 ] = PORTSTATE_RESET;
-					if ( hcd->get_port_stat( portID ).get_connection() ) {
-						logger->info(" - Completing reset on port");
-						hcd->port_reset_done( portID, true );
-					}
-					emit portStatusChanged( portID, PORTSTATE_RESET );
-				}
-				if ( psw->triggers_suspend() ) {
-					logger->info(QString("USB Port #%1 suspend").
-							arg(QString::number(portID)));
-					portStatusList[ portID -1 ].portStatus = TI_USB_VHCI::PORTSTATE_SUSPENDED;
-					if ( portStatusList[psw->get_port()-1].portInUse ) {
-
-						// port is in use by us!urbOrig->get_buffer()
-						// TODO send signal and disconnect all devices
-					}
-				}
-				if ( psw->triggers_disable() ) {
-					logger->info(QString("USB Port #%1 disabled").
-							arg(QString::number(portID)));
-					// -> Signal is emitted when a device is disconnected from system
-					//    should be handled equivalent to "power on"!
-					portStatusList[ portID -1 ].portStatus = TI_USB_VHCI::PORTSTATE_POWERON;
-					portStatusList[ portID -1 ].portOK = true;
-					if ( portStatusList[psw->get_port()-1].portInUse ) {
-						// port is in use by us!urbOrig->get_buffer()
-						// TODO send signal and disconnect all devices
-					}
-				}
-				if ( psw->triggers_resuming() ) {
-					logger->info(QString("USB Port #%1 resuming").
-							arg(QString::number(portID)));
-					portStatusList[ portID -1 ].portStatus = TI_USB_VHCI::PORTSTATE_POWERON;
-					if ( hcd->get_port_stat( portID ).get_connection() ) {
-						hcd->port_resumed( portID );
-					}
-					emit portStatusChanged( portID, PORTSTATE_RESUME );
-				}
-				if ( psw->triggers_power_on() ) {
-					logger->info(QString("USB Port #%1 powered on").
-							arg(QString::number(portID)));
-					portStatusList[ portID -1 ].portStatus = TI_USB_VHCI::PORTSTATE_POWERON;
-					portStatusList[ portID -1 ].portOK = true;
-					if ( portStatusList[psw->get_port()-1].portInUse ) {
-						// port is in use by us!
-						emit portStatusChanged( portID, PORTSTATE_POWERON );
-					}
-				}
-				hcd->finish_work(work);
-			} // portstatus
-
-			else if( usb::vhci::process_urb_work* puw = dynamic_cast<usb::vhci::process_urb_work*>(work) ) {
-				uint8_t portID = puw->get_port();
-				if ( !puw->is_canceled() ) {
-					logger->debug(QString("Process URB for port %1").arg( QString::number(portID) ) );
-					// get URB data from work structure
-					usb::urb* urbData = puw->get_urb();
-					if ( urbData ) {
-						portStatusList[portID -1].lastURBhandle = urbData->get_handle();
-						portStatusList[portID-1].packetCount++;
-
-						if ( portStatusList[portID-1].deviceInInitPhase ) {
-							// if we are still in init phase all communication is performed here!
-							if ( urbData->is_control() ) {
-								// Check for "GET_DESCRIPTOR(device)" request
-								if ( urbData->get_bmRequestType() == 0x80 &&
-										urbData->get_bRequest() == 0x06 &&
-										urbData->get_wValue() == 0x0100 ) {
-									if ( portStatusList[portID-1].initialConnectDeviceDescriptor ) {
-										if ( logger->isDebugEnabled() )
-											logger->debug("Sending fake device descriptor...");
-										// send device descriptor
-										int lenMax = urbData->get_wLength();
-										QByteArray * deviceDescriptor = portStatusList[portID-1].initialConnectDeviceDescriptor;
-										if ( deviceDescriptor->length() < lenMax ) lenMax = deviceDescriptor->length();
-										const char* replyRawData = deviceDescriptor->constData();
-										std::copy( replyRawData, replyRawData + lenMax, urbData->get_buffer() );	// copy data
-										urbData->set_buffer_actual( lenMax );
-										urbData->ack();
-										// clean up
-										delete portStatusList[portID-1].initialConnectDeviceDescriptor;
-										portStatusList[portID-1].initialConnectDeviceDescriptor = NULL;
-										hcd->finish_work(work);
-										continue;
-									} else {
-										// Problem!
-										logger->error("Not sending fake device descriptor - ERROR");
+	}
+}
+
+void LinuxVHCIconnector::processWork( int hcdIndex, usb::vhci::work * work ) {
+	usb::vhci::local_hcd * hcd = hcds[hcdIndex];
+	if ( usb::vhci::port_stat_work* psw = dynamic_cast<usb::vhci::port_stat_work*>(work) ) {
+		// Host changes status of port (port number of host controller -> our port number)
+		uint8_t hcdPort = psw->get_port();
+		int portID = portIDofHcdPort( hcdIndex, hcdPort );
+		if( psw->triggers_power_off() ) {
+			logger->info(QString("USB Port #%1 powered off").
+					arg(QString::number(portID)));
+			portStatusList[ portID -1 ].portStatus = TI_USB_VHCI::PORTSTATE_DISABLED;
+			if ( portStatusList[ portID -1 ].portInUse ) {
+				// port is in use by us!
+				// TODO send signal and disconnect all devices
+				//						logger->info(QString("port #%1 not in use?").arg( QString::number(portID) ) );
+				portStatusList[portID-1].deviceInInitPhase = true;
+			}
+		}
+		if ( psw->triggers_reset() ) {
+			logger->info(QString("USB Port #%1 reset").
+					arg(QString::number(portID)));
+			// portStatusList[ portID -1 ] = PORTSTATE_RESET;
+			if ( hcd->get_port_stat( hcdPort ).get_connection() ) {
+				logger->info(" - Completing reset on port");
+				hcd->port_reset_done( hcdPort, true );
+			}
+			emit portStatusChanged( portID, PORTSTATE_RESET );
+		}
+		if ( psw->triggers_suspend() ) {
+			logger->info(QString("USB Port #%1 suspend").
+					arg(QString::number(portID)));
+			portStatusList[ portID -1 ].portStatus = TI_USB_VHCI::PORTSTATE_SUSPENDED;
+			if ( portStatusList[portID-1].portInUse ) {
+
+				// port is in use by us!urbOrig->get_buffer()
+				// TODO send signal and disconnect all devices
+			}
+		}
+		if ( psw->triggers_disable() ) {
+			logger->info(QString("USB Port #%1 disabled").
+					arg(QString::number(portID)));
+			// -> Signal is emitted when a device is disconnected from system
+			//    should be handled equivalent to "power on"!
+			portStatusList[ portID -1 ].portStatus = TI_USB_VHCI::PORTSTATE_POWERON;
+			portStatusList[ portID -1 ].portOK = true;
+			if ( portStatusList[portID-1].portInUse ) {
+				// port is in use by us!urbOrig->get_buffer()
+				// TODO send signal and disconnect all devices
+			}
+		}
+		if ( psw->triggers_resuming() ) {
+			logger->info(QString("USB Port #%1 resuming").
+					arg(QString::number(portID)));
+			portStatusList[ portID -1 ].portStatus = TI_USB_VHCI::PORTSTATE_POWERON;
+			if ( hcd->get_port_stat( hcdPort ).get_connection() ) {
+				hcd->port_resumed( hcdPort );
+			}
+			emit portStatusChanged( portID, PORTSTATE_RESUME );
+		}
+		if ( psw->triggers_power_on() ) {
+			logger->info(QString("USB Port #%1 powered on").
+					arg(QString::number(portID)));
+			portStatusList[ portID -1 ].portStatus = TI_USB_VHCI::PORTSTATE_POWERON;
+			portStatusList[ portID -1 ].portOK = true;
+			if ( portStatusList[portID-1].portInUse ) {
+				// port is in use by us!
+				emit portStatusChanged( portID, PORTSTATE_POWERON );
+			}
+		}
+		hcd->finish_work(work);
+	} // portstatus
+
+	else if( usb::vhci::process_urb_work* puw = dynamic_cast<usb::vhci::process_urb_work*>(work) ) {
+		int portID = portIDofHcdPort( hcdIndex, puw->get_port() );
+		if ( !puw->is_canceled() ) {
+			logger->debug(QString("Process URB for port %1").arg( QString::number(portID) ) );
+			// get URB data from work structure
+			usb::urb* urbData = puw->get_urb();
+			if ( urbData ) {
+				portStatusList[portID-1].packetCount++;
+
+				if ( portStatusList[portID-1].deviceInInitPhase ) {
+					// if we are still in init phase all communication is performed here!
+					if ( urbData->is_control() ) {
+						// Check for "GET_DESCRIPTOR(device)" request
+						if ( urbData->get_bmRequestType() == 0x80 &&
+								urbData->get_bRequest() == 0x06 &&
+								urbData->get_wValue() == 0x0100 ) {
+							if ( portStatusList[portID-1].initialConnectDeviceDescriptor ) {
+								if ( logger->isDebugEnabled() )
+									logger->debug("Sending fake device descriptor...");
+								// send device descriptor
+								int lenMax = urbData->get_wLength();
+								QByteArray * deviceDescriptor = portStatusList[portID-1].initialConnectDeviceDescriptor;
+								if ( deviceDescriptor->length() < lenMax ) lenMax = deviceDescriptor->length();
+								const char* replyRawData = deviceDescriptor->constData();
+								std::copy( replyRawData, replyRawData + lenMax, urbData->get_buffer() );	// copy data
+								urbData->set_buffer_actual( lenMax );
+								urbData->ack();
+								// clean up
+								delete portStatusList[portID-1].initialConnectDeviceDescriptor;
+								portStatusList[portID-1].initialConnectDeviceDescriptor = NULL;
+								hcd->finish_work(work);
+								return;
+							} else {
+								// Problem!
+								logger->error("Not sending fake device descriptor - ERROR");
 //										urbData->stall();
-									}
-								} else if ( urbData->get_bmRequestType() == 0x00 &&
-										urbData->get_bRequest() == 0x05 ) {
-									// host is setting device enumeration number
-									uint16_t devAddress = urbData->get_wValue();
-									logger->info(QString("Host sets address %1 for device.").arg(QString::number(devAddress) ) );
-									portStatusList[portID-1].portEnumeratedByHost = (uint8_t) devAddress;
-
-									portStatusList[portID-1].deviceInInitPhase = false;
-									urbData->ack();
-									hcd->finish_work(work);
-									continue;
-								}
-							} else
-								portStatusList[portID-1].deviceInInitPhase = false;
-						}
-						// communicate with network stack
-
-						// emit urb data to receiver
-						uint8_t endPtNo = urbData->get_endpoint_number();	// which endpoint
-						uint16_t xferFlags = urbData->get_flags();  // transfer flags
-						TI_WusbStack::eDataDirectionType dirType =
-								urbData->is_out()? TI_WusbStack::DATADIRECTION_OUT : TI_WusbStack::DATADIRECTION_IN;
-						TI_WusbStack::eDataTransferType xferType = TI_WusbStack::CONTROL_TRANSFER;
-						if ( urbData->is_control() )
-							xferType = TI_WusbStack::CONTROL_TRANSFER;
-						else if ( urbData->is_bulk() )
-							xferType = TI_WusbStack::BULK_TRANSFER;
-						else if ( urbData->is_interrupt() )
-							xferType = TI_WusbStack::INTERRUPT_TRANSFER;
-						else if ( urbData->is_isochronous() )
-							xferType = TI_WusbStack::ISOCHRONOUS_TRANSFER;
-
-						uint32_t xferInterval = urbData->get_interval();
-
-						QByteArray * urbRawData = new QByteArray;
-						createURBfromInternalStruct( urbData, *urbRawData, portID );
-						switch ( portID ) {
-						case 1:
-							emit urbDataSend1( puw, xferFlags, endPtNo,
-									xferType, dirType,
-									urbRawData, (uint8_t) xferInterval, urbData->get_buffer_length() );
-							break;
-						case 2:
-							emit urbDataSend2( puw, xferFlags, endPtNo,
-									xferType, dirType,
-									urbRawData, (uint8_t) xferInterval, urbData->get_buffer_length() );
-							break;
-						case 3:
-							emit urbDataSend3( puw, xferFlags, endPtNo,
-									xferType, dirType,
-									urbRawData, (uint8_t) xferInterval, urbData->get_buffer_length() );
-							break;
-						case 4:
-							emit urbDataSend4( puw, xferFlags, endPtNo,
-									xferType, dirType,
-									urbRawData, (uint8_t) xferInterval, urbData->get_buffer_length() );
-							break;
-						case 5:
-							emit urbDataSend5( puw, xferFlags, endPtNo,
-									xferType, dirType,
-									urbRawData, (uint8_t) xferInterval, urbData->get_buffer_length() );
-							break;
-						case 6:
-							emit urbDataSend6( puw, xferFlags, endPtNo,
-									xferType, dirType,
-									urbRawData, (uint8_t) xferInterval, urbData->get_buffer_length() );
-							break;
-						case 7:
-							emit urbDataSend7( puw, xferFlags, endPtNo,
-									xferType, dirType,
-									urbRawData, (uint8_t) xferInterval, urbData->get_buffer_length() );
-							break;
-						case 8:
-							emit urbDataSend8( puw, xferFlags, endPtNo,
-									xferType, dirType,
-									urbRawData, (uint8_t) xferInterval, urbData->get_buffer_length() );
-							break;
+							}
+						} else if ( urbData->get_bmRequestType() == 0x00 &&
+								urbData->get_bRequest() == 0x05 ) {
+							// host is setting device enumeration number
+							uint16_t devAddress = urbData->get_wValue();
+							logger->info(QString("Host sets address %1 for device.").arg(QString::number(devAddress) ) );
+							portStatusList[portID-1].portEnumeratedByHost = (uint8_t) devAddress;
+
+							portStatusList[portID-1].deviceInInitPhase = false;
+							urbData->ack();
+							hcd->finish_work(work);
+							return;
 						}
 					} else
-						logger->warn("URB work - but no URB data???");
-				} else {
-					if ( logger->isDebugEnabled() )
-						logger->debug(QString("Got canceled URB for port %1").arg( QString::number(portID) ) );
+						portStatusList[portID-1].deviceInInitPhase = false;
+				}
+				// enumeration of a known device is answered locally
+				if ( urbData->is_control() && answerFromDescriptorCache( portID, urbData ) ) {
+					hcd->finish_work(work);
+					return;
 				}
-			}
 
-			else if( usb::vhci::cancel_urb_work* cuw = dynamic_cast<usb::vhci::cancel_urb_work*>(work) ) {
-				uint8_t portID = cuw->get_port();
-				logger->info(QString("Cancel URB for port %1").arg( QString::number( portID ) ) );
-				// assuming that canceled packet was last sent packet...
-				portStatusList[portID -1].lastURBhandle = 0L;
-				// TODO cancel URB in wusb stack
-				hcd->finish_work(work);
-			}
+				// communicate with network stack
+
+				// emit urb data to receiver
+				uint8_t endPtNo = urbData->get_endpoint_number();	// which endpoint
+				uint16_t xferFlags = urbData->get_flags();  // transfer flags
+				TI_WusbStack::eDataDirectionType dirType =
+						urbData->is_out()? TI_WusbStack::DATADIRECTION_OUT : TI_WusbStack::DATADIRECTION_IN;
+				TI_WusbStack::eDataTransferType xferType = TI_WusbStack::CONTROL_TRANSFER;
+				if ( urbData->is_control() )
+					xferType = TI_WusbStack::CONTROL_TRANSFER;
+				else if ( urbData->is_bulk() )
+					xferType = TI_WusbStack::BULK_TRANSFER;
+				else if ( urbData->is_interrupt() )
+					xferType = TI_WusbStack::INTERRUPT_TRANSFER;
+				else if ( urbData->is_isochronous() )
+					xferType = TI_WusbStack::ISOCHRONOUS_TRANSFER;
+
+				uint32_t xferInterval = urbData->get_interval();
+
+				URBDescriptor_t request;
+				request.refData = NULL;
+				request.cancelRequest = false;
+				request.transferFlags = xferFlags;
+				request.endpoint = endPtNo;
+				request.transferType = xferType;
+				request.direction = dirType;
+				request.intervalVal = (uint8_t) xferInterval;
+				request.expectedReceiveLength = urbData->get_buffer_length();
+				if ( isoPacketTable && urbData->is_isochronous() )
+					// answer carries actual length and status of each packet
+					request.expectedReceiveLength += WUSB_ISO_TABLE_HEADER_LEN +
+							urbData->get_iso_packet_count() * WUSB_ISO_PACKET_DESCRIPTOR_LEN;
+				request.urbData = new QByteArray;
+				createURBfromInternalStruct( urbData, *request.urbData, portID );
+
+				// pass URB to network stack of port (every URB needs a free slot in reply ring)
+				// - any number of URBs (of all endpoints) may be outstanding at the same time
+				URBReference_t * urbRef = NULL;
+				if ( !portStatusList[portID-1].freeURBReferences.isEmpty() ) {
+					urbRef = portStatusList[portID-1].freeURBReferences.last();
+					urbRef->work = puw;
+					request.refData = urbRef;
+				}
+				if ( urbRef && portStatusList[portID-1].urbChannel->postRequest( request ) ) {
+					portStatusList[portID-1].freeURBReferences.remove( portStatusList[portID-1].freeURBReferences.size() - 1 );
+					portStatusList[portID-1].outstandingURBs.insert( urbData->get_handle(), urbRef );
+					portStatusList[portID-1].outstandingURBsByEndpoint[ urbData->get_endpoint_address() ]++;
+					if ( logger->isTraceEnabled() )
+						logger->trace(QString("Port %1: %2 URBs outstanding (%3 on endpoint 0x%4)").arg(
+								QString::number( portID ),
+								QString::number( portStatusList[portID-1].outstandingURBs.size() ),
+								QString::number( portStatusList[portID-1].outstandingURBsByEndpoint[ urbData->get_endpoint_address() ] ),
+								QString::number( urbData->get_endpoint_address(), 16 ) ) );
+				} else {
+					logger->warn(QString("Too many outstanding URBs on port %1 - URB rejected").arg( QString::number(portID) ) );
+					delete request.urbData;
+					urbData->set_status( USB_VHCI_STATUS_ERROR );
+					hcd->finish_work(work);
+				}
+			} else
+				logger->warn("URB work - but no URB data???");
+		} else {
+			if ( logger->isDebugEnabled() )
+				logger->debug(QString("Got canceled URB for port %1").arg( QString::number(portID) ) );
+			hcd->finish_work(work);
+		}
+	}
 
-			else {
-				// ???
-				logger->warn("Unknown work object!?");
-				hcd->finish_work(work);
-			}
+	else if( usb::vhci::cancel_urb_work* cuw = dynamic_cast<usb::vhci::cancel_urb_work*>(work) ) {
+		int portID = portIDofHcdPort( hcdIndex, cuw->get_port() );
+		uint64_t handle = cuw->get_handle();
+		logger->info(QString("Cancel URB for port %1").arg( QString::number( portID ) ) );
+		URBReference_t * canceledURB = portStatusList[portID -1].outstandingURBs.value( handle, NULL );
+		if ( canceledURB ) {
+			hcd->cancel_process_urb_work( handle );
+			// network stack drops URB if not sent until now - URB is finished with its reply
+			URBDescriptor_t request;
+			request.refData = canceledURB;
+			request.cancelRequest = true;
+			request.urbData = NULL;
+			if ( !portStatusList[portID -1].urbChannel->postRequest( request ) )
+				logger->warn(QString("Cannot pass cancel request to network stack (port %1)").arg( QString::number( portID ) ) );
 		}
+		hcd->finish_work(work);
+	}
+
+	else {
+		// ???
+		logger->warn("Unknown work object!?");
+		hcd->finish_work(work);
 	}
 }
 
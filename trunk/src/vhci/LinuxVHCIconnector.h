@@ -12,17 +12,31 @@
 #include <libusb_vhci.h>
 #include "../TI_WusbStack.h"
 #include "../TI_USB_VHCI.h"
+#include "URBChannel.h"
+#include "../USBdescriptorCache.h"
 #include <QThread>
 #include <QQueue>
 #include <QMap>
+#include <QHash>
+#include <QVector>
 #include <QByteArray>
 
 class Logger;
 class QMutex;
-class QWaitCondition;
 class USBTechDevice;
 
+/** Number of ports if not configured (<tt>vhci.numberOfPorts</tt>) */
 #define LINUX_VHCI_DEFAULT_NUMBER_OF_PORTS		6
+/** Max. number of ports of one virtual host controller (limit of a root hub) */
+#define LINUX_VHCI_MAX_PORTS_PER_HCD			31
+/** Max. number of ports over all virtual host controllers */
+#define LINUX_VHCI_MAX_NUMBER_OF_PORTS			248
+/** Time (ms) a port is held connected while network connection of device is reestablished (<tt>vhci.holdGracePeriod</tt>) */
+#define LINUX_VHCI_DEFAULT_HOLD_GRACE_PERIOD	5000
+/** Max. number of events taken with one call of <tt>epoll_wait()</tt> */
+#define LINUX_VHCI_MAX_EPOLL_EVENTS				16
+/** Event ID of wakeup eventfd in epoll set (IDs of reply eventfds are port indexes) */
+#define LINUX_VHCI_WAKEUP_EVENT_ID				0xffffffffu
 
 class LinuxVHCIconnector : public TI_USB_VHCI {
 	Q_OBJECT
@@ -43,7 +57,8 @@ public:
 
 	/**
 	 * Opens (Linux-) kernel <em>usb-vhci</em> interface. A (by configuration) specified
-	 * number of ports (default: <tt>6</tt>) are allocated on a virtual usb hub.
+	 * number of ports (default: <tt>6</tt>) are allocated on virtual usb hubs: one host
+	 * controller is opened for each 31 ports. Port numbers are counted over all host controllers.
 	 * @return	<code>true</code> if device could be opened, <code>false</code> if not.
 	 */
 	virtual bool openInterface();
@@ -74,6 +89,23 @@ public:
 	 * Disconnect device on given port from OS.
 	 */
 	bool disconnectDevice( int portID );
+	/**
+	 * Keeps device on given port connected to host while its network connection is lost:
+	 * URBs of host are queued in URB channel of port (no network stack attached). If port is
+	 * not released within grace period, connection worker has to disconnect the device (queued
+	 * URBs are given back as failed by its network stack).
+	 * @return	<code>false</code> if port is not in use or holding is disabled (grace period <tt>0</tt>)
+	 */
+	bool holdPort( int portID );
+	/**
+	 * Ends holding of port - network stack may attach to URB channel again.
+	 * @return	<code>false</code> if grace period is over (device is disconnected by connector)
+	 */
+	bool releasePort( int portID );
+	/** Port is held and grace period is not over */
+	bool isPortHeld( int portID );
+	/** Grace period (ms) of a held port - <tt>0</tt> if holding is disabled */
+	int getHoldGracePeriod() const { return holdGracePeriodMillis; }
 	/**
 	 * Start working thread. The worker thread is needed to query kernel interface for new data.
 	 */
@@ -86,9 +118,20 @@ public:
 
 	/**
 	 * Passes back an answer (URB) to host for request specified by <tt>refData</tt>.
+	 * Answers of a port must be given back by one thread only (the thread taking requests of port).
 	 * @see TI_USB_VHCI
 	 */
 	virtual void giveBackAnswerURB( void * refData, bool isOK, QByteArray * urbData );
+	virtual void giveBackAnswerURB( void * refData, bool isOK, const PooledBuffer & urbData );
+	virtual PooledBuffer reserveAnswerBuffer( void * refData, int length );
+
+	/**
+	 * Returns the URB channel of given port. URBs from host are posted to this
+	 * channel and must be taken by exactly one network stack.
+	 * @param	portID	port number
+	 * @return	channel or <tt>NULL</tt> if port number is invalid
+	 */
+	URBChannel * getURBChannel( int portID );
 
 	/**
 	 * Thread run loop.<br>
@@ -105,14 +148,22 @@ private:
 		usb::data_rate dataRate;
 		USBTechDevice * refDevice;
 		QByteArray * initialDeviceDescriptor;
+		/** Descriptors of device from cache (empty if device is not known) */
+		USBdescriptorSet cachedDescriptors;
 	};
-	struct DeviceURBreplyData {
-		eDeviceURBAnswerType status;
-		usb::vhci::process_urb_work * refURB;
-		QByteArray * dataURB;
+	/** Reference data of an URB passed to network stack */
+	struct URBReference_t {
+		/** URB work of host - <tt>NULL</tt> for requests of connector (descriptor validation) */
+		usb::vhci::process_urb_work * work;
+		/** Port number (counted over all host controllers) */
+		int portID;
 	};
 	/** Describes all status data for one virtual USB port. */
 	struct PortStatusData_t {
+		/** Host controller of port (index) */
+		int hcdIndex;
+		/** Port number on its host controller */
+		uint8_t hcdPort;
 		/** USB hub port is working at all */
 		bool portOK;
 		/** USB hub port is currently in use */
@@ -128,10 +179,28 @@ private:
 		/** Flag if a new connected device is still in "init phase"
 		 * (the host will perform a port reset and send port enumeration data after that) */
 		bool deviceInInitPhase;
-		/** handle ID of last URB send from host */
-		uint64_t lastURBhandle;
 		/** packet counter for debug purpose (counting each send packet) */
 		unsigned int packetCount;
+		/** URBs passed to network stack without answer - by URB handle (limited by size of reply ring) */
+		QHash<uint64_t, URBReference_t*> outstandingURBs;
+		/** Number of outstanding URBs of each endpoint (endpoint address incl. direction bit) */
+		QHash<uint8_t, int> outstandingURBsByEndpoint;
+		/** Hand-off of URBs to/from network stack */
+		URBChannel * urbChannel;
+		/** Reply eventfd of port was signaled (set by <tt>waitForWork()</tt>) */
+		bool replyEventPending;
+		/** Reference data for URBs of port - one entry for each slot of reply ring */
+		URBReference_t * urbReferences;
+		/** Entries of <tt>urbReferences</tt> not used by an outstanding URB */
+		QVector<URBReference_t*> freeURBReferences;
+		/** Descriptors of connected device from cache - enumeration requests are answered locally */
+		USBdescriptorSet cachedDescriptors;
+		/** Descriptors answered by device over network (stored in cache when enumeration is done) */
+		USBdescriptorSet capturedDescriptors;
+		/** Device descriptor was requested from device to validate cached descriptors */
+		bool descriptorValidationPending;
+		/** End of grace period of a held port (<tt>0</tt> if port is not held) - guarded by request queue mutex */
+		long long holdDeadlineMillis;
 	};
 
 	/** Singleton instance */
@@ -144,6 +213,10 @@ private:
 	int numberOfPorts;
 	/** Flag if worker should run. (@see <tt>startWork()</tt>) */
 	bool shouldRun;
+	/** Grace period (ms) of a held port */
+	int holdGracePeriodMillis;
+	/** Flag: isochronous URBs are passed with packet tables (see <tt>TI_WusbStack.h</tt>) */
+	bool isoPacketTable;
 
 	/** Array for each port of virtual hub with used status */
 	bool* portInUseList;
@@ -151,20 +224,17 @@ private:
 	/** Array for each port with port status information */
 	PortStatusData_t * portStatusList;
 
-	/** Connection to (virtual) host controller device */
-	usb::vhci::local_hcd * hcd;
-	/** Current work to do on device */
-	usb::vhci::work* work;
+	/** Connections to (virtual) host controller devices (<tt>NULL</tt> if interface is closed) */
+	usb::vhci::local_hcd ** hcds;
+	/** Number of host controllers needed for all ports */
+	int numberOfHcds;
 	/** Flag indicating that the kernel interface is usable */
 	bool kernelInterfaceUsable;
 
-	/** Mutex for synchronization of usb interaction with kernel */
-	static QMutex * workInProgressMutex;
-	/** Wait condition for synchronization of usb interaction with kernel */
-	static QWaitCondition * workInProgressCondition;
-	/** Flag indicating work with kernel interface is in progress */
-	static bool isWorkInProgress;
-	static bool isWaitingForWork;
+	/** Wakes up worker thread (kernel work enqueued, connection requests) */
+	int wakeupEventFD;
+	/** epoll set the worker thread is waiting on (wakeup eventfd + reply eventfd of each port) */
+	int workEpollFD;
 
 	/** Timestamp indicating a time when a subsequent connection request can be performed
 	 *  (this is necessary to limit connection requests) */
@@ -174,17 +244,19 @@ private:
 	QQueue< struct DeviceConnectionData_t > deviceConnectionRequestQueue;
 	/** Mutex to protect device connect operation queue */
 	QMutex * connectionRequestQueueMutex;
-	/** A queue for "URB reply from device" data */
-	QQueue< struct DeviceURBreplyData >   deviceReplyDataQueue;
-	/** Mutex to gard reply from device queue */
-	QMutex * deviceReplyDataQueueMutex;
 
 
 
 	/** Finds an unused port */
 	int getUnusedPort();
-
-	/** Internal callback of last packet state */
+	/** Host controller of given port */
+	usb::vhci::local_hcd * hcdOfPort( int portID );
+	/** Port number (counted over all host controllers) of a port of given host controller */
+	static int portIDofHcdPort( int hcdIndex, uint8_t hcdPort );
+	/** Process work of host controller (port status, URBs, canceled URBs) */
+	void processWork( int hcdIndex, usb::vhci::work * work );
+
+	/** Callback of hcd: kernel work is enqueued (<tt>arg</tt> is connector instance) */
 	static void signal_work_enqueued( void* arg, usb::vhci::hcd& from ) throw();
 
 	/**
@@ -193,9 +265,27 @@ private:
 	 * @see <tt>disconnectDevice</tt>
 	 */
 	bool processOutstandingConnectionRequests();
+	/** Disconnects device on port: outstanding URBs are canceled (finished with reply of network stack) */
+	void disconnectPort( int portID );
+	/**
+	 * Ends holding of ports whose grace period is over (device is disconnected by its connection worker).
+	 * @return	end of next grace period of a held port (<tt>0</tt> if no port is held)
+	 */
+	long long processExpiredPortHolds();
 
+	/** Post answer to reply ring of port */
+	void postURBreply( URBReply_t & replyData );
+	/** Pass all answers posted to URB channels of ports back to host */
 	bool processOutstandingURBReplys();
 
+	/** Wake up worker thread waiting for work */
+	void wakeupWorker();
+	/**
+	 * Block worker thread until work is enqueued, an answer is posted or timeout occurs.
+	 * Ports with posted answers are marked. Timeout <tt>-1</tt> waits without limit.
+	 */
+	void waitForWork( long timeoutMillis );
+
 	/**
 	 * Creates device descriptor data from a USBTechDevice description.
 	 * Device descriptor data will be written to given byte array.
@@ -203,36 +293,37 @@ private:
 	 * @param	bytes	Reference to a allocated byte array.
 	 */
 	void createDeviceDescriptorFromDeviceDescription( USBTechDevice * device, QByteArray & bytes );
+	/**
+	 * Data rate to attach device with: speed told by cached descriptors of device (real endpoint
+	 * sizes) - USB version of device description if descriptors are not known or do not tell.
+	 */
+	usb::data_rate determineDataRate( USBTechDevice * device, const USBdescriptorSet & descriptors );
 
 	void createURBfromInternalStruct( usb::urb * urbData, QByteArray & buffer, int portID = 0 );
+	/**
+	 * Answers GET_DESCRIPTOR request from cached descriptors of port.
+	 * @return	<code>false</code> if URB has to be passed to device
+	 */
+	bool answerFromDescriptorCache( int portID, usb::urb * urbData );
+	/** Reads device descriptor from device (answer is compared with cached descriptor) */
+	void requestDescriptorValidation( int portID );
+	/** Drops cached descriptors if answer of device does not match */
+	void validateCachedDescriptors( int portID, const URBReply_t & replyData );
+	/** Keeps answer of GET_DESCRIPTOR request for descriptor cache */
+	void captureDescriptor( int portID, usb::urb * urbData );
+	/** Stores descriptors captured on port in descriptor cache (if complete) */
+	void storeCapturedDescriptors( int portID );
+	/** Appends packet table of an isochronous URB to <tt>buffer</tt> */
+	void appendIsoPacketTable( usb::urb * urbData, QByteArray & buffer );
+	/**
+	 * Fills packets of an isochronous URB with answer of device (actual lengths, status and data).
+	 * A missing or failed answer marks all packets as failed.
+	 */
+	void completeIsoURB( usb::urb * urbData, const char * answer, int answerLength );
 
 
 signals:
 	void portStatusChanged( uint8_t portID, ePortStatus portState );
-	void urbDataSend1( void * refData, uint16_t transferFlags, uint8_t endPointNo,
-			TI_WusbStack::eDataTransferType transferType, TI_WusbStack::eDataDirectionType dDirection,
-			QByteArray * urbData, uint8_t intervalVal, int expectedReturnLength );
-	void urbDataSend2( void * refData, uint16_t transferFlags, uint8_t endPointNo,
-			TI_WusbStack::eDataTransferType transferType, TI_WusbStack::eDataDirectionType dDirection,
-			QByteArray * urbData, uint8_t intervalVal, int expectedReturnLength );
-	void urbDataSend3( void * refData, uint16_t transferFlags, uint8_t endPointNo,
-			TI_WusbStack::eDataTransferType transferType, TI_WusbStack::eDataDirectionType dDirection,
-			QByteArray * urbData, uint8_t intervalVal, int expectedReturnLength );
-	void urbDataSend4( void * refData, uint16_t transferFlags, uint8_t endPointNo,
-			TI_WusbStack::eDataTransferType transferType, TI_WusbStack::eDataDirectionType dDirection,
-			QByteArray * urbData, uint8_t intervalVal, int expectedReturnLength );
-	void urbDataSend5( void * refData, uint16_t transferFlags, uint8_t endPointNo,
-			TI_WusbStack::eDataTransferType transferType, TI_WusbStack::eDataDirectionType dDirection,
-			QByteArray * urbData, uint8_t intervalVal, int expectedReturnLength );
-	void urbDataSend6( void * refData, uint16_t transferFlags, uint8_t endPointNo,
-			TI_WusbStack::eDataTransferType transferType, TI_WusbStack::eDataDirectionType dDirection,
-			QByteArray * urbData, uint8_t intervalVal, int expectedReturnLength );
-	void urbDataSend7( void * refData, uint16_t transferFlags, uint8_t endPointNo,
-			TI_WusbStack::eDataTransferType transferType, TI_WusbStack::eDataDirectionType dDirection,
-			QByteArray * urbData, uint8_t intervalVal, int expectedReturnLength );
-	void urbDataSend8( void * refData, uint16_t transferFlags, uint8_t endPointNo,
-			TI_WusbStack::eDataTransferType transferType, TI_WusbStack::eDataDirectionType dDirection,
-			QByteArray * urbData, uint8_t intervalVal, int expectedReturnLength );
 };
 
 #endif /* LINUXVHCICONNECTOR_H_ */
@@ -0,0 +1,86 @@
+/**
+ * URBChannel.cpp
+ *
+ * @author:		Sebastian Kolbe-Nusser &lt;Sebastian DOT Kolbe AT gmail DOT com&gt;
+ * @version:	$Id$
+ * @created:	2011-04-20
+ */
+
+#include "URBChannel.h"
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+
+URBChannel::URBChannel( int port ) {
+	portID = port;
+	requestEventFD = ::eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+	replyEventFD = ::eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+}
+
+URBChannel::~URBChannel() {
+	if ( requestEventFD >= 0 ) ::close( requestEventFD );
+	if ( replyEventFD >= 0 ) ::close( replyEventFD );
+}
+
+bool URBChannel::isValid() const {
+	return requestEventFD >= 0 && replyEventFD >= 0;
+}
+
+int URBChannel::getPortID() const {
+	return portID;
+}
+
+bool URBChannel::postRequest( const URBDescriptor_t & request ) {
+	bool wakeup;
+	if ( !requestQueue.push( request, wakeup ) ) return false;
+	// consumer still draining requests posted before: no additional wakeup (system call) needed
+	if ( wakeup )
+		signalEventFD( requestEventFD );
+	return true;
+}
+
+bool URBChannel::takeRequest( URBDescriptor_t & request ) {
+	return requestQueue.pop( request );
+}
+
+int URBChannel::getRequestEventFD() const {
+	return requestEventFD;
+}
+
+void URBChannel::clearRequestEvent() {
+	clearEventFD( requestEventFD );
+}
+
+bool URBChannel::postReply( const URBReply_t & reply ) {
+	bool wakeup;
+	if ( !replyQueue.push( reply, wakeup ) ) return false;
+	// answers of a burst are completed with one wakeup of VHCI worker
+	if ( wakeup )
+		signalEventFD( replyEventFD );
+	return true;
+}
+
+bool URBChannel::takeReply( URBReply_t & reply ) {
+	return replyQueue.pop( reply );
+}
+
+int URBChannel::getReplyEventFD() const {
+	return replyEventFD;
+}
+
+void URBChannel::clearReplyEvent() {
+	clearEventFD( replyEventFD );
+}
+
+void URBChannel::signalEventFD( int fd ) {
+	if ( fd < 0 ) return;
+	uint64_t value = 1;
+	// counter cannot overflow in practice - and a failed write still leaves fd readable
+	while ( ::write( fd, &value, sizeof(value) ) < 0 && errno == EINTR );
+}
+
+void URBChannel::clearEventFD( int fd ) {
+	if ( fd < 0 ) return;
+	uint64_t value;
+	while ( ::read( fd, &value, sizeof(value) ) < 0 && errno == EINTR );
+}
@@ -0,0 +1,100 @@
+/**
+ * URBChannel.h
+ * Hand-off of URBs between VHCI worker thread and network stack of one virtual port.
+ * Each direction is a lock free single producer / single consumer ring with an
+ * <em>eventfd</em> to wake up the consumer.
+ *
+ * @author:		Sebastian Kolbe-Nusser &lt;Sebastian DOT Kolbe AT gmail DOT com&gt;
+ * @version:	$Id$
+ * @created:	2011-04-20
+ */
+
+#ifndef URBCHANNEL_H_
+#define URBCHANNEL_H_
+
+#include "../TI_WusbStack.h"
+#include "../TI_USB_VHCI.h"
+#include "../utils/SPSCQueue.h"
+#include <stdint.h>
+
+class QByteArray;
+
+/** Number of slots of each ring (power of two) - max. number of URBs outstanding on one port */
+#define URB_CHANNEL_CAPACITY		256
+
+/** URB request passed from host (VHCI) to network stack */
+struct URBDescriptor_t {
+	/** Reference data of URB - given back with answer */
+	void * refData;
+	/** Cancels URB <tt>refData</tt> posted before (all other fields are unused) */
+	bool cancelRequest;
+	/** Raw URB data (ownership passes to stack) */
+	QByteArray * urbData;
+	uint16_t transferFlags;
+	uint8_t endpoint;
+	uint8_t intervalVal;
+	TI_WusbStack::eDataTransferType transferType;
+	TI_WusbStack::eDataDirectionType direction;
+	int expectedReceiveLength;
+};
+
+/** Answer of device passed from network stack back to host (VHCI) */
+struct URBReply_t {
+	/** Reference data of request */
+	void * refData;
+	TI_USB_VHCI::eDeviceURBAnswerType status;
+	/** Answer data (ownership passes to VHCI) - may be <tt>NULL</tt> */
+	QByteArray * urbData;
+	/** Answer data from receive buffer pool (alternative to <tt>urbData</tt>) - released by VHCI */
+	PooledBuffer pooledData;
+};
+
+class URBChannel {
+public:
+	URBChannel( int portID );
+	virtual ~URBChannel();
+
+	/** Both eventfds could be created */
+	bool isValid() const;
+	int getPortID() const;
+
+	/* Request direction: VHCI worker thread (producer) -> network stack (consumer) */
+
+	/**
+	 * Pass URB to stack and wake up stack (only if stack has taken all requests posted before).
+	 * @return <code>false</code> if ring is full
+	 */
+	bool postRequest( const URBDescriptor_t & request );
+	/** Take next URB (consumer only). @return <code>false</code> if there is no request */
+	bool takeRequest( URBDescriptor_t & request );
+	/** File descriptor readable if requests were posted */
+	int getRequestEventFD() const;
+	/** Reset wakeup of request consumer - must be called before draining requests */
+	void clearRequestEvent();
+
+	/* Reply direction: network stack (producer) -> VHCI worker thread (consumer) */
+
+	/**
+	 * Pass answer to VHCI and wake up worker (only if worker has taken all answers posted before).
+	 * @return <code>false</code> if ring is full
+	 */
+	bool postReply( const URBReply_t & reply );
+	/** Take next answer (consumer only). @return <code>false</code> if there is no answer */
+	bool takeReply( URBReply_t & reply );
+	/** File descriptor readable if replies were posted */
+	int getReplyEventFD() const;
+	/** Reset wakeup of reply consumer - must be called before draining replies */
+	void clearReplyEvent();
+
+private:
+	int portID;
+	int requestEventFD;
+	int replyEventFD;
+	SPSCQueue<URBDescriptor_t, URB_CHANNEL_CAPACITY> requestQueue;
+	SPSCQueue<URBReply_t, URB_CHANNEL_CAPACITY> replyQueue;
+
+	static void signalEventFD( int fd );
+	static void clearEventFD( int fd );
+};
+
+#endif /* URBCHANNEL_H_ */